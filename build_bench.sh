@@ -0,0 +1 @@
+g++ -Wextra -Wall -fexceptions -Wno-unused -fno-strict-aliasing -std=c++17 -Wno-uninitialized -O2 util.cpp json.cpp json_stream.cpp json_scan.cpp json_snapshot.cpp json_tape.cpp json_digest.cpp thread_pool.cpp json_bench.cpp -pthread -o json_bench
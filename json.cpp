@@ -14,129 +14,139 @@
   */
 
 #include "json.h"
+#include "json_internal.h"
+#include "thread_pool.h"
 #include <cmath>
 #include <cstring>
 #include <stdexcept>
+#include <charconv>
+#include <algorithm>
+#include <ostream>
+#include <thread>
+#include <exception>
 
 namespace JSON {
     
-    namespace {
+    namespace Internal {
         
-        constexpr bool is_whitespace(char c){
-            return c==' '||c=='\t'||c=='\r'||c=='\n';
+        bool is_number_start_nosign(std::string_view data, size_t i){
+            return is_number(data[i])||(data[i]=='.'&&(i+1<data.size())&&is_number(data[i+1]));
         }
         
-        constexpr bool is_word_start(char c){
-            return (c>='a'&&c<='z')||(c>='A'&&c<='Z')||c=='_';
+        bool is_number_start(std::string_view data, size_t i){
+            return is_number_start_nosign(data,i)||((data[i]=='-'||data[i]=='+')&&(i+1<data.size())&&is_number_start_nosign(data,i+1));
         }
         
-        constexpr bool is_number(char c){
-            return (c>='0'&&c<='9');
-        }
+        //powers of ten that are exactly representable as doubles
+        constexpr double exact_pow10[]={
+            1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+            1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22,
+        };
         
-        constexpr bool is_word_char(char c){
-            return (c>='a'&&c<='z')||(c>='A'&&c<='Z')||(c>='0'&&c<='9')||c=='_';
-        }
+        constexpr int max_mantissa_digits=19;//any 19 digit number fits in a uint64_t
         
-        bool is_number_start_nosign(const std::string &data, size_t i){
-            return is_number(data[i])||(data[i]=='.'&&(i+1<data.size())&&is_number(data[i+1]));
+        void unexpected_char(const std::string &expected,char c,size_t pos){
+            throw std::runtime_error("Expected "+expected+", got '"+c+"' at pos "+std::to_string(pos));
         }
         
-        bool is_number_start(const std::string &data, size_t i){
-            return is_number_start_nosign(data,i)||((data[i]=='-'||data[i]=='+')&&(i+1<data.size())&&is_number_start_nosign(data,i+1));
+        void unexpected_eof(const std::string &expected){
+            throw std::runtime_error("Expected "+expected+", got EOF");
         }
         
-        Element get_number(const std::string &data, size_t &i){//handles integers, decimals and scientific notation
-            if(i>=data.size()) throw std::runtime_error("Expected Number, got EOF");
-            union {
-                int64_t i=0;
-                double d;
-            } num;
-            bool is_double=false;
-            bool valid=false;
-            bool is_negative=data[i]=='-';
-            ssize_t double_depth=1;
-            
+        number_parts_t scan_number(std::string_view data, size_t &i,size_t pos){
+            if(i>=data.size()) unexpected_eof("Number");
+            number_parts_t n;
+            n.start=i;
+            n.is_negative=data[i]=='-';
             if(data[i]=='-'||data[i]=='+')i++;
+            n.number_start=i;
             
-            for(;i<data.size();i++){
-                if(!is_double&&data[i]=='.'){
-                    is_double=true;
-                    num.d=num.i;
-                }else if(data[i]=='e'||data[i]=='E'){
-                    i++;
-                    bool negative=false;
-                    ssize_t exponent=0;
-                    valid=false;
-                    if(i<data.size()&&(data[i]=='+'||data[i]=='-')){
-                        if(data[i]=='-')negative=true;
-                        i++;
-                    }
-                    for(;i<data.size();i++){
-                        if(data[i]>='0'&&data[i]<='9'){
-                            valid=true;
-                            (exponent*=10)+=data[i]-'0';
-                        }else{
-                            break;
-                        }
-                    }
-                    if(is_double){
-                        num.d=num.d*std::pow(10,negative?-exponent:exponent);
-                    }else{
-                        num.d=num.i*std::pow(10,negative?-exponent:exponent);
-                        is_double=true;
-                    }
-                    break;
-                }else if(data[i]>='0'&&data[i]<='9'){
+            bool valid=false;
+            
+            for(;i<data.size()&&is_number(data[i]);i++){
+                valid=true;
+                if(n.digits<max_mantissa_digits){
+                    n.mantissa=n.mantissa*10+(data[i]-'0');
+                    if(n.mantissa!=0)n.digits++;
+                }else{
+                    n.truncated=true;
+                    n.exponent++;
+                }
+            }
+            if(i<data.size()&&data[i]=='.'){
+                n.is_double=true;
+                for(i++;i<data.size()&&is_number(data[i]);i++){
                     valid=true;
-                    if(is_double){
-                        num.d+=(data[i]-'0')*std::pow(10,-(double_depth++));
+                    if(n.digits<max_mantissa_digits){
+                        n.mantissa=n.mantissa*10+(data[i]-'0');
+                        if(n.mantissa!=0)n.digits++;
+                        n.exponent--;
                     }else{
-                        (num.i*=10)+=data[i]-'0';
+                        n.truncated=true;
                     }
-                }else{
-                    break;
                 }
             }
+            if(valid&&i<data.size()&&(data[i]=='e'||data[i]=='E')){
+                n.is_double=true;
+                valid=false;
+                i++;
+                bool negative=false;
+                int64_t exp=0;
+                if(i<data.size()&&(data[i]=='+'||data[i]=='-')){
+                    if(data[i]=='-')negative=true;
+                    i++;
+                }
+                for(;i<data.size()&&is_number(data[i]);i++){
+                    valid=true;
+                    if(exp<100000)(exp*=10)+=data[i]-'0';//anything past this is infinity or zero anyway
+                }
+                n.exponent+=negative?-exp:exp;
+            }
             
             if(!valid){
-                if(data.size()>=i){
-                    throw std::runtime_error("Expected Number, got EOF");
-                }else{
-                    throw std::runtime_error(std::string("Expected Number, got '")+data[i]+"' at pos "+std::to_string(i));
-                }
-            }else if(is_double){
-                return is_negative?-num.d:num.d;
-            }else{
-                return is_negative?-num.i:num.i;
+                if(i>=data.size()) unexpected_eof("Number");
+                unexpected_char("Number",data[i],pos+i);
             }
+            return n;
         }
         
-        constexpr char unescape(char c){
-            switch(c) {
-            case 'a':
-                return '\a';
-            case 'b':
-                return '\b';
-            case 'e':
-                return '\e';
-            case 'f':
-                return '\f';
-            case 'n':
-                return '\n';
-            case 'r':
-                return '\r';
-            case 't':
-                return '\t';
-            case 'v':
-                return '\v';
-            case '\\':
-                return '\\';
-            case '"':
-                return '\"';
-            default:
-                return c;
+        Element get_number(std::string_view data, size_t &i,size_t pos){
+            const number_parts_t n=scan_number(data,i,pos);
+            if(n.is_int()){
+                return int64_t(n.is_negative?0-n.mantissa:n.mantissa);
+            }
+            
+            //exact mantissa and power of ten, a single correctly rounded operation gives the correctly rounded result
+            if(!n.truncated&&n.mantissa<=(uint64_t(1)<<53)&&n.exponent>=-22&&n.exponent<=22){
+                double d=double(n.mantissa);
+                d=n.exponent<0?d/exact_pow10[-n.exponent]:d*exact_pow10[n.exponent];
+                return n.is_negative?-d:d;
             }
+            
+            //from_chars does the slow cases with correct rounding, but doesn't accept a '+' sign
+            double d;
+            auto [ptr,ec]=std::from_chars(data.data()+(n.is_negative?n.start:n.number_start),data.data()+i,d);
+            if(ec==std::errc::result_out_of_range){
+                d=(n.exponent+n.digits>0)?HUGE_VAL:0.0;
+                if(n.is_negative)d=-d;
+            }else if(ec!=std::errc()||ptr!=data.data()+i){
+                throw std::runtime_error("Invalid Number at pos "+std::to_string(pos+n.start));
+            }
+            return d;
+        }
+        
+        size_t format_double(double d,char * buf){
+            if(!std::isfinite(d)){//json can't represent nan or infinity
+                memcpy(buf,"null",4);
+                return 4;
+            }
+            char * end=std::to_chars(buf,buf+max_double_chars,d).ptr;
+            //keep whole numbers looking like doubles so they parse back as one
+            if(std::find_if(buf,end,[](char c){return c=='.'||c=='e';})==end){
+                *end++='.';
+                *end++='0';
+            }
+            return end-buf;
         }
         
         std::string escape_char_str(char c){
@@ -166,66 +176,128 @@ namespace JSON {
             }
         }
         
-        inline bool is_char(const std::string &data, size_t &i,char c){
-            return (i<data.size())&&(data[i]==c);
-        }
-        
-        inline void expect_char(const std::string &data, size_t &i,char c){
-            if(i>=data.size()) throw std::runtime_error("Expected '"+escape_char_str(c)+"', got EOF");
-            if(data[i]!=c) throw std::runtime_error("Expected '"+escape_char_str(c)+"', got '"+data[i]+"' at pos "+std::to_string(i));
-        }
-        
-        Element get_string(const std::string &data, size_t &i){
+        std::string_view get_string_raw(std::string_view data, size_t &i,bool &escaped){
             expect_char(data,i,'"');
             i++;
             size_t start=i;
-            size_t n=0;
-            for(;i<data.size();i++){
+            escaped=false;
+            for(;(i=scan_string(data,i))<data.size();i++){
                 if(data[i]=='\n'){
-                    continue;
+                    escaped=true;
                 }else if(data[i]=='\\'){
+                    escaped=true;
                     i++;
-                    n++;
-                }else if(data[i]=='"'){
-                    std::string str;
-                    str.reserve(n);
-                    for(size_t j=start;j<i;j++){
-                        if(data[j]=='\n'){
-                            continue;
-                        }else if(data[j]=='\\'){
-                            j++;
-                            str+=unescape(data[j]);
-                        }else{
-                            str+=data[j];
-                        }
-                    }
+                }else{
                     i++;
-                    return str;
+                    std::string_view raw=data.substr(start,i-start-1);
+                    check_string(raw,start,escaped);
+                    return raw;
+                }
+            }
+            unexpected_eof(quote_char('"'));
+        }
+        
+        constexpr int hex_digit(char c){
+            return (c>='0'&&c<='9')?c-'0':(c>='a'&&c<='f')?c-'a'+10:(c>='A'&&c<='F')?c-'A'+10:-1;
+        }
+        
+        void check_string(std::string_view raw,size_t pos,bool escaped){
+            size_t bad=scan_utf8(raw,0);
+            if(bad<raw.size()) throw std::runtime_error("Invalid UTF-8 at pos "+std::to_string(pos+bad));
+            if(!escaped)return;
+            for(size_t j=0;(j=scan_char(raw,j,'\\'))<raw.size();j+=2){
+                if(j+1<raw.size()&&raw[j+1]=='u'){
+                    for(size_t k=j+2;k<j+6;k++){
+                        if(k>=raw.size()) throw std::runtime_error("Expected hex digit, got '\"' at pos "+std::to_string(pos+k));
+                        if(hex_digit(raw[k])<0) throw std::runtime_error("Expected hex digit, got '"+escape_char_str(raw[k])+"' at pos "+std::to_string(pos+k));
+                    }
+                }
+            }
+        }
+        
+        namespace {
+            
+            uint32_t get_hex4(const char * p){
+                return (hex_digit(p[0])<<12)|(hex_digit(p[1])<<8)|(hex_digit(p[2])<<4)|hex_digit(p[3]);
+            }
+            
+            size_t encode_utf8(uint32_t cp,char * out){
+                if(cp<0x80){
+                    out[0]=char(cp);
+                    return 1;
+                }else if(cp<0x800){
+                    out[0]=char(0xC0|(cp>>6));
+                    out[1]=char(0x80|(cp&0x3F));
+                    return 2;
+                }else if(cp<0x10000){
+                    out[0]=char(0xE0|(cp>>12));
+                    out[1]=char(0x80|((cp>>6)&0x3F));
+                    out[2]=char(0x80|(cp&0x3F));
+                    return 3;
                 }else{
-                    n++;
+                    out[0]=char(0xF0|(cp>>18));
+                    out[1]=char(0x80|((cp>>12)&0x3F));
+                    out[2]=char(0x80|((cp>>6)&0x3F));
+                    out[3]=char(0x80|(cp&0x3F));
+                    return 4;
+                }
+            }
+            
+            //decodes the \u escape at 'j', and the low surrogate escape following it if there's one, returns the length of the escapes
+            size_t unescape_unicode(std::string_view raw,size_t j,char * out,size_t &n){
+                uint32_t cp=get_hex4(raw.data()+j+2);
+                size_t len=6;
+                if(cp>=0xD800&&cp<=0xDBFF){
+                    uint32_t lo;
+                    if(j+12<=raw.size()&&raw[j+6]=='\\'&&raw[j+7]=='u'&&(lo=get_hex4(raw.data()+j+8))>=0xDC00&&lo<=0xDFFF){
+                        cp=0x10000+((cp-0xD800)<<10)+(lo-0xDC00);
+                        len=12;
+                    }else{
+                        cp=0xFFFD;
+                    }
+                }else if(cp>=0xDC00&&cp<=0xDFFF){
+                    cp=0xFFFD;
                 }
+                n+=encode_utf8(cp,out+n);
+                return len;
             }
-            throw std::runtime_error("Expected '\"', got EOF");
+            
         }
         
-        void skip_whitespace(const std::string &data, size_t &i){ //SAFE TO CALL ON EOF, TODO skip comments
-            while(i<data.size()){
-                if(is_whitespace(data[i])){
-                    i++;
-                }else if(data[i]=='#'){
-                    i++;
-                    while(i<data.size()&&data[i]!='\n')i++;
+        size_t unescape_str(std::string_view raw,char * out){
+            size_t n=0;
+            size_t j=0;
+            while(j<raw.size()){
+                size_t end=scan_string(raw,j);//raw contents can only have escaped quotes
+                memmove(out+n,raw.data()+j,end-j);
+                n+=end-j;
+                if(end==raw.size())break;
+                if(raw[end]=='\\'){
+                    if(raw[end+1]=='u'){
+                        j=end+unescape_unicode(raw,end,out,n);
+                        continue;
+                    }
+                    out[n++]=unescape(raw[end+1]);
+                    end++;
+                }
+                j=end+1;
+            }
+            return n;
+        }
+        
+        void skip_whitespace(std::string_view data, size_t &i){
+            while((i=scan_non_whitespace(data,i))<data.size()){
+                if(data[i]=='#'){
+                    i=scan_char(data,i+1,'\n');
                     if(i<data.size())i++;
                 }else if(data[i]=='/'&&(i+1<data.size())&&(data[i+1]=='/'||data[i+1]=='*')){
                     if(data[i+1]=='/'){
-                        i+=2;
-                        while(i<data.size()&&data[i]!='\n')i++;
+                        i=scan_char(data,i+2,'\n');
                         if(i<data.size())i++;
                     }else{
-                        i+=2;
-                        if(i<data.size())i++;
-                        while(i<data.size()&&!(data[i-1]=='*'&&data[i]=='/'))i++;
-                        if(i<data.size())i++;
+                        //the '*' of "/*" can't also close it
+                        for(i+=2;(i=scan_char(data,i,'*'))<data.size()&&!(i+1<data.size()&&data[i+1]=='/');i++);
+                        i=std::min(i+2,data.size());
                     }
                 }else{
                     break;
@@ -233,104 +305,302 @@ namespace JSON {
             }
         }
         
-        Element get_element(const std::string &data, size_t &i);
+        bool get_literal(std::string_view data, size_t &i,JSON_Literal &l){
+            if((i+3)<data.size()&&data[i]=='n'&&data[i+1]=='u'&&data[i+2]=='l'&&data[i+3]=='l'){
+                i+=4;
+                l=JSON_NULL;
+            }else if((i+3)<data.size()&&data[i]=='t'&&data[i+1]=='r'&&data[i+2]=='u'&&data[i+3]=='e'){
+                i+=4;
+                l=JSON_TRUE;
+            }else if((i+4)<data.size()&&data[i]=='f'&&data[i+1]=='a'&&data[i+2]=='l'&&data[i+3]=='s'&&data[i+4]=='e'){
+                i+=5;
+                l=JSON_FALSE;
+            }else{
+                return false;
+            }
+            return true;
+        }
         
-        Element get_array(const std::string &data, size_t &i){
-            expect_char(data,i,'[');
-            i++;
+        void skip_element(std::string_view data, size_t &i){
             skip_whitespace(data,i);
-            if(is_char(data,i,']')){
+            if(i>=data.size()) unexpected_eof("JSON");
+            bool escaped;
+            JSON_Literal l;
+            switch(data[i]){
+            case '"':
+                get_string_raw(data,i,escaped);
+                return;
+            case '[':
+            case '{':{
+                    const char close=data[i]=='['?']':'}';
+                    size_t depth=0;
+                    while((i=scan_structural(data,i))<data.size()){
+                        switch(data[i]){
+                        case '"':
+                            get_string_raw(data,i,escaped);
+                            continue;
+                        case '#':
+                        case '/':{
+                                size_t start=i;
+                                skip_whitespace(data,i);
+                                if(i==start)i++;
+                            }
+                            continue;
+                        case '[':
+                        case '{':
+                            depth++;
+                            break;
+                        case ']':
+                        case '}':
+                            if(--depth==0){
+                                i++;
+                                return;
+                            }
+                            break;
+                        }
+                        i++;
+                    }
+                    unexpected_eof(quote_char(close));
+                }
+            default:
+                if(is_number_start(data,i)){
+                    get_number(data,i);
+                    return;
+                }else if(get_literal(data,i,l)){
+                    return;
+                }
+            }
+            unexpected_char("JSON",data[i],i);
+        }
+        
+    }
+    
+    namespace {
+        
+        using namespace Internal;
+        
+        struct parse_context {
+            char * insitu;//writable buffer that 'data' views, if not null, strings are unescaped in place and returned as views
+            std::pmr::memory_resource * res;//resource all strings and containers are allocated from
+            size_t max_depth;//containers nested deeper than this are an error
+            Interner * strings;//if not null, keys and short values are interned into it instead of being copied
+            size_t depth=0;//containers already open around the element, when it's parsed on its own out of a larger document
+        };
+        
+        //unescapes in place when parsing in situ and into 'scratch' otherwise, so the result is only valid until the next call
+        std::string_view get_string_view(std::string_view data, size_t &i,const parse_context &ctx,std::pmr::string &scratch){
+            bool escaped;
+            std::string_view raw=get_string_raw(data,i,escaped);
+            if(!escaped) return raw;
+            char * out;
+            if(ctx.insitu){
+                out=ctx.insitu+(raw.data()-data.data());
+            }else{
+                scratch.resize(raw.size());
+                out=scratch.data();
+            }
+            return std::string_view(out,unescape_str(raw,out));
+        }
+        
+        Element get_string_element(std::string_view data, size_t &i,const parse_context &ctx,std::pmr::string &scratch){
+            std::string_view s=get_string_view(data,i,ctx,scratch);
+            if(ctx.strings&&s.size()>Element::short_size&&s.size()<=ctx.strings->max_value_size) return StringView(ctx.strings->intern(s));//short strings are stored inline anyway
+            return ctx.insitu?StringView(s):String(s,ctx.res);
+        }
+        
+        Key get_key(std::string_view data, size_t &i,const parse_context &ctx,std::pmr::string &scratch){
+            std::string_view s=get_string_view(data,i,ctx,scratch);
+            if(ctx.strings&&s.size()>Key::inline_size) return Key::view(ctx.strings->intern(s));//short keys are stored inline anyway
+            return ctx.insitu?Key::view(s):Key(s,ctx.res);
+        }
+        
+        //a container that is still being filled, only one of 'arr' and 'obj' is set
+        struct frame_t {
+            array_t * arr;
+            object_t * obj;
+        };
+        
+        constexpr size_t inline_frames=64;//frames that fit in the parser's own stack space before the frame stack has to allocate
+        
+        //iterative, containers are pushed onto an explicit stack and values are built directly inside them instead of being returned up a call chain
+        Element get_element(std::string_view data, size_t &i,const parse_context &ctx){
+            alignas(frame_t) std::byte frame_buf[inline_frames*sizeof(frame_t)];
+            std::pmr::monotonic_buffer_resource frame_res(frame_buf,sizeof(frame_buf));
+            std::pmr::vector<frame_t> stack(&frame_res);
+            stack.reserve(inline_frames);
+            
+            Element root(JSON_NULL);
+            Key key;//key of the next value if the top of the stack is an object
+            std::pmr::string scratch(ctx.res);//in the same arena as the document, if there is one
+            
+            //stores a finished or newly opened value in the innermost open container
+            auto store=[&](Element &&e) -> Element& {
+                if(stack.empty()) return root=std::move(e);
+                if(stack.back().arr) return stack.back().arr->emplace_back(std::move(e));
+                return stack.back().obj->emplace_unsorted(std::move(key),std::move(e));
+            };
+            
+            auto next_key=[&](){
+                key=get_key(data,i,ctx,scratch);
+                skip_whitespace(data,i);
+                expect_char(data,i,':');
                 i++;
-                return JSON::Array({});
+            };
+            
+            while(true){
+                skip_whitespace(data,i);
+                if(i>=data.size()) unexpected_eof("JSON");
+                JSON_Literal l;
+                switch(data[i]){
+                case '[':
+                case '{':{
+                        const bool is_obj=data[i]=='{';
+                        if(ctx.depth+stack.size()>=ctx.max_depth) throw std::runtime_error("Maximum nesting depth of "+std::to_string(ctx.max_depth)+" exceeded at pos "+std::to_string(i));
+                        const char close=is_obj?'}':']';
+                        i++;
+                        skip_whitespace(data,i);
+                        if(i>=data.size()) unexpected_eof(quote_char(close));
+                        if(data[i]==close){
+                            i++;
+                            store(is_obj?JSON::Object(object_t(ctx.res)):JSON::Array(array_t(ctx.res)));
+                            break;
+                        }
+                        if(is_obj){
+                            Element &e=store(JSON::Object(object_t(ctx.res)));
+                            stack.push_back({nullptr,&e.get_obj()});
+                            next_key();
+                        }else{
+                            Element &e=store(JSON::Array(array_t(ctx.res)));
+                            stack.push_back({&e.get_arr(),nullptr});
+                        }
+                    }
+                    continue;
+                case '"':
+                    store(get_string_element(data,i,ctx,scratch));
+                    break;
+                default:
+                    if(is_number_start(data,i)){
+                        store(get_number(data,i));
+                        break;
+                    }else if(get_literal(data,i,l)){
+                        store(l);
+                        break;
+                    }
+                    unexpected_char("JSON",data[i],i);
+                }
+                
+                //a value just ended, close every container that ends after it, then move on to the next value, trailing commas are allowed
+                while(!stack.empty()){
+                    const frame_t f=stack.back();
+                    const char close=f.obj?'}':']';
+                    skip_whitespace(data,i);
+                    if(i>=data.size()) unexpected_eof(quote_char(close));
+                    if(data[i]!=close){
+                        expect_char(data,i,',');
+                        i++;
+                        skip_whitespace(data,i);
+                        if(i>=data.size()) unexpected_eof(quote_char(close));
+                        if(data[i]!=close){
+                            if(f.obj)next_key();
+                            break;
+                        }
+                    }
+                    i++;
+                    if(f.obj)f.obj->sort();
+                    stack.pop_back();
+                }
+                if(stack.empty()) return root;
             }
-            std::vector<Element> v;
+        }
+        
+        std::optional<Element> select_element(std::string_view data, size_t &i,const parse_context &ctx,const Query &q,size_t node);
+        
+        Element select_array(std::string_view data, size_t &i,const parse_context &ctx,const Query &q,size_t node){
+            expect_char(data,i,'[');
+            i++;
+            array_t v(ctx.res);
+            size_t index=0;
             while(i<data.size()){
                 skip_whitespace(data,i);
-                v.emplace_back(get_element(data,i));
-                skip_whitespace(data,i);
-                if(i<data.size()&&data[i]==']'){
+                if(is_char(data,i,']')){
                     i++;
                     return JSON::Array(std::move(v));
                 }
-                expect_char(data,i,',');
-                i++;
+                size_t child=q.child(node,index++);
+                if(child==Query::npos){
+                    skip_element(data,i);
+                }else if(std::optional<Element> e=select_element(data,i,ctx,q,child)){
+                    v.emplace_back(std::move(*e));
+                }
                 skip_whitespace(data,i);
-                if(i<data.size()&&data[i]==']'){
+                if(is_char(data,i,']')){
                     i++;
                     return JSON::Array(std::move(v));
                 }
+                expect_char(data,i,',');
+                i++;
             }
-            throw std::runtime_error("Expected ']', got EOF");
+            unexpected_eof(quote_char(']'));
         }
         
-        Element get_object(const std::string &data, size_t &i){
+        Element select_object(std::string_view data, size_t &i,const parse_context &ctx,const Query &q,size_t node){
             expect_char(data,i,'{');
             i++;
-            skip_whitespace(data,i);
-            if(is_char(data,i,'}')){
-                i++;
-                return JSON::Object({});
-            }
-            std::map<std::string,Element> m;
+            object_t m(ctx.res);
+            std::string unescaped;
             while(i<data.size()){
                 skip_whitespace(data,i);
-                std::string key=std::move(std::get<std::string>(get_string(data,i).data));
+                if(is_char(data,i,'}')){
+                    i++;
+                    m.sort();
+                    return JSON::Object(std::move(m));
+                }
+                bool escaped;
+                std::string_view key=get_string_raw(data,i,escaped);
+                if(escaped){
+                    unescaped.resize(key.size());
+                    unescaped.resize(unescape_str(key,unescaped.data()));
+                    key=unescaped;
+                }
                 skip_whitespace(data,i);
                 expect_char(data,i,':');
                 i++;
+                size_t child=q.child(node,key);
+                if(child==Query::npos){
+                    skip_element(data,i);
+                }else if(std::optional<Element> e=select_element(data,i,ctx,q,child)){
+                    m.emplace_unsorted(key,std::move(*e));
+                }
                 skip_whitespace(data,i);
-                m.insert({key,get_element(data,i)});
-                skip_whitespace(data,i);
-                if(i<data.size()&&data[i]=='}'){
+                if(is_char(data,i,'}')){
                     i++;
+                    m.sort();
                     return JSON::Object(std::move(m));
                 }
                 expect_char(data,i,',');
                 i++;
-                skip_whitespace(data,i);
-                if(i<data.size()&&data[i]=='}'){
-                    i++;
-                    return JSON::Object(std::move(m));
-                }
             }
-            throw std::runtime_error("Expected '}', got EOF");
+            unexpected_eof(quote_char('}'));
         }
         
-        Element get_element(const std::string &data, size_t &i){
+        //containers on the way to a selected path are kept even if nothing inside them matched, other unselected values are skipped
+        std::optional<Element> select_element(std::string_view data, size_t &i,const parse_context &ctx,const Query &q,size_t node){
+            if(q.is_match(node)) return get_element(data,i,ctx);
             skip_whitespace(data,i);
-            if(i>=data.size()) throw std::runtime_error("Expected JSON, got EOF");
-            switch(data[i]){
-            case '[':
-                return get_array(data,i);
-            case '{':
-                return get_object(data,i);
-            case '"':
-                return get_string(data,i);
-            default:
-                if(is_number_start(data,i)){
-                    return get_number(data,i);
-                }else if((i+3)<data.size()&&data[i]=='n'&&data[i+1]=='u'&&data[i+2]=='l'&&data[i+3]=='l'){
-                    i+=4;
-                    return JSON_NULL;
-                }else if((i+3)<data.size()&&data[i]=='t'&&data[i+1]=='r'&&data[i+2]=='u'&&data[i+3]=='e'){
-                    i+=4;
-                    return JSON_TRUE;
-                }else if((i+4)<data.size()&&data[i]=='f'&&data[i+1]=='a'&&data[i+2]=='l'&&data[i+3]=='s'&&data[i+4]=='e'){
-                    i+=5;
-                    return JSON_FALSE;
-                }
+            if(is_char(data,i,'[')){
+                return select_array(data,i,ctx,q,node);
+            }else if(is_char(data,i,'{')){
+                return select_object(data,i,ctx,q,node);
             }
-            throw std::runtime_error(std::string("Expected JSON, got '")+data[i]+"' at pos "+std::to_string(i));
+            skip_element(data,i);
+            return std::nullopt;
         }
         
+        //only the short escapes json has, \a \e and \v are read but never written, other control characters are written as \u00XX
         constexpr char escape(char c){
             switch(c) {
-            case '\a':
-                return 'a';
             case '\b':
                 return 'b';
-            case '\e':
-                return 'e';
             case '\f':
                 return 'f';
             case '\n':
@@ -339,8 +609,6 @@ namespace JSON {
                 return 'r';
             case '\t':
                 return 't';
-            case '\v':
-                return 'v';
             case '\\':
                 return '\\';
             case '"':
@@ -349,109 +617,434 @@ namespace JSON {
                 return c;
             }
         }
+    }
+    
+    std::string Element::to_json(bool trailing_quote,size_t depth) const {
+        std::string s;
+        Writer(s,true,trailing_quote).write(*this,depth);
+        return s;
+    }
+    
+    std::string Element::to_json_min() const {
+        std::string s;
+        Writer(s,false,false).write(*this);
+        return s;
+    }
+    
+    Writer::Writer(std::string &out,bool pretty,bool trailing_comma) : buf(out), stream(nullptr), pretty(pretty), trailing_comma(pretty&&trailing_comma) {
+    }
+    
+    Writer::Writer(std::ostream &out,bool pretty,bool trailing_comma) : buf(own), stream(&out), pretty(pretty), trailing_comma(pretty&&trailing_comma) {
+        own.reserve(flush_size+flush_size/4);
+    }
+    
+    Writer::~Writer(){
+        flush();
+    }
+    
+    void Writer::flush(){
+        if(stream&&!buf.empty()){
+            stream->write(buf.data(),buf.size());
+            buf.clear();
+        }
+    }
+    
+    void Writer::newline(size_t depth){
+        if(pretty){
+            buf+='\n';
+            buf.append(depth*4,' ');
+        }
+    }
+    
+    void Writer::write_str(std::string_view s){
+        buf+='"';
+        size_t start=0;
+        for(size_t i=0;i<s.size();i++){
+            char c=s[i];
+            if(c=='\\'||c=='"'||static_cast<unsigned char>(c)<0x20){//copy everything up to the escape in one go
+                buf.append(s.data()+start,i-start);
+                buf+='\\';
+                if(escape(c)!=c){
+                    buf+=escape(c);
+                }else{
+                    buf+="u00";
+                    buf+="0123456789abcdef"[c>>4];
+                    buf+="0123456789abcdef"[c&15];
+                }
+                start=i+1;
+            }
+        }
+        buf.append(s.data()+start,s.size()-start);
+        buf+='"';
+    }
+    
+    //iterative like get_element, the containers being written are kept on an explicit stack, with the index of the next value to write in each
+    void Writer::write(const Element &e,size_t depth){
+        struct frame_t {
+            const Element * e;
+            size_t next;
+            size_t size;
+            bool is_obj;
+        };
+        alignas(frame_t) std::byte frame_buf[inline_frames*sizeof(frame_t)];
+        std::pmr::monotonic_buffer_resource frame_res(frame_buf,sizeof(frame_buf));
+        std::pmr::vector<frame_t> stack(&frame_res);
+        stack.reserve(inline_frames);
         
-        inline std::string quote_str(std::string s){
-            std::string str;
-            str.reserve(s.size()+10);
-            str+='"';
-            for(char c:s){
-                if(c=='\\'||c=='"'||escape(c)!=c){
-                    str+='\\';
-                    str+=escape(c);
+        //writes scalars whole, containers are only opened, the loop below writes what's inside them
+        auto value=[&](const Element &v){
+            if(v.is_int()){
+                char tmp[24];
+                buf.append(tmp,std::to_chars(tmp,tmp+sizeof(tmp),v.get_int()).ptr);
+            }else if(v.is_double()){
+                char tmp[max_double_chars];
+                buf.append(tmp,format_double(v.get_double(),tmp));
+            }else if(v.is_str()){//string or string view
+                write_str(v.get_str_view());
+            }else if(v.is_bool()){
+                buf+=v.get_bool()?"true":"false";
+            }else if(v.is_null()){
+                buf+="null";
+            }else if(v.is_arr()||v.is_obj()){
+                buf+=v.is_arr()?'[':'{';
+                stack.push_back({&v,0,v.size(),v.is_obj()});
+            }
+        };
+        
+        value(e);
+        while(!stack.empty()){
+            const size_t level=stack.size();
+            frame_t &f=stack.back();
+            const size_t inner=depth+level;//indentation of the values inside the container
+            //values are written until one of them is a container, which is pushed and written first, 'f' can't be used once that happens
+            while(stack.size()==level&&f.next<f.size){
+                if(f.next>0)buf+=',';
+                newline(inner);
+                const Element * v;
+                if(f.is_obj){
+                    auto &kv=*(f.e->get_obj().begin()+f.next);
+                    write_str(kv.first);
+                    buf+=pretty?" : ":":";
+                    v=&kv.second;
                 }else{
-                    str+=c;
+                    v=&f.e->get_arr()[f.next];
                 }
+                f.next++;
+                value(*v);
+                if(stream&&buf.size()>=flush_size)flush();
             }
-            str+='"';
-            return str;
+            if(stack.size()!=level)continue;
+            if(trailing_comma&&f.size>0)buf+=',';
+            newline(inner-1);
+            buf+=f.is_obj?'}':']';
+            stack.pop_back();
         }
+    }
+    
+    //containers are copied one at a time, with null placeholders for the containers inside them, which are queued to be copied into the placeholders next
+    void Element::copy_tree(const Element &other){
+        u.literal=JSON_NULL;
+        set_tag(TAG_LITERAL);
+        using frame_t=std::pair<Element*,const Element*>;//placeholder, what's copied into it
+        alignas(frame_t) std::byte frame_buf[inline_frames*sizeof(frame_t)];
+        std::pmr::monotonic_buffer_resource frame_res(frame_buf,sizeof(frame_buf));
+        std::pmr::vector<frame_t> stack(&frame_res);
+        stack.reserve(inline_frames);
         
-        inline std::string indent(size_t depth){
-            return std::string(depth*4,' ');
+        auto copy=[](const Element &e){ return (e.is_arr()||e.is_obj())?Element(JSON_NULL):Element(e); };
+        try{
+            stack.emplace_back(this,&other);
+            while(!stack.empty()){
+                auto [to,from]=stack.back();
+                stack.pop_back();
+                if(from->is_arr()){
+                    const array_t &src=*from->u.arr;
+                    array_t arr;
+                    arr.reserve(src.size());
+                    for(const Element &e:src){
+                        arr.emplace_back(copy(e));
+                    }
+                    to->set_box(TAG_ARR,to->u.arr,std::move(arr));
+                    for(size_t k=0;k<src.size();k++){
+                        if(src[k].is_arr()||src[k].is_obj())stack.emplace_back(&(*to->u.arr)[k],&src[k]);
+                    }
+                }else{
+                    const object_t &src=*from->u.obj;
+                    object_t obj;
+                    obj.reserve(src.size());
+                    for(auto &[k,e]:src){
+                        obj.emplace_unsorted(k,copy(e));//already sorted
+                    }
+                    to->set_box(TAG_OBJ,to->u.obj,std::move(obj));
+                    auto it=to->u.obj->begin();
+                    for(auto &[k,e]:src){
+                        if(e.is_arr()||e.is_obj())stack.emplace_back(&it->second,&e);
+                        ++it;
+                    }
+                }
+            }
+        }catch(...){
+            free();//placeholders that weren't copied into yet are still null, so this only frees what was copied
+            throw;
         }
     }
     
-    std::string Element::to_json(bool trailing_quote,size_t depth) const {
-        if(std::holds_alternative<int64_t>(data)){//int
-            return std::to_string(get_int());
-        }else if(std::holds_alternative<double>(data)){//double
-            return std::to_string(get_double());
-        }else if(std::holds_alternative<std::string>(data)){//string
-            return quote_str(get_str());
-        }else if(std::holds_alternative<JSON_Literal>(data)){//literal
-            return std::get<JSON_Literal>(data)==JSON_TRUE?"true":std::get<JSON_Literal>(data)==JSON_FALSE?"false":"null";
-        }else if(std::holds_alternative<std::vector<Element>>(data)){//array
-            return "[\n"+({
-                std::string s;
-                bool first=true;
-                for(auto &e:get_arr()){
-                    if(!first)s+=",\n";
-                    s+=indent(depth+1);
-                    s+=e.to_json(trailing_quote,depth+1);
-                    first=false;
+    //containers holding only scalars and empty containers are deleted directly, destroying those doesn't go any deeper
+    //otherwise the containers inside are moved out onto an explicit stack first, then the ones inside those, and so on,
+    //so every container is deleted once it has nothing nested left in it, and freeing takes the same call stack space however deep the tree is
+    void Element::free_container() noexcept {
+        auto any_children=[](const Element &c){
+            if(c.tag()==TAG_ARR) return std::any_of(c.u.arr->begin(),c.u.arr->end(),[](const Element &e){ return e.has_children(); });
+            return std::any_of(c.u.obj->begin(),c.u.obj->end(),[](const object_t::value_type &kv){ return kv.second.has_children(); });
+        };
+        if(any_children(*this)){
+            alignas(Element) std::byte frame_buf[inline_frames*sizeof(Element)];
+            std::pmr::monotonic_buffer_resource frame_res(frame_buf,sizeof(frame_buf));
+            std::pmr::vector<Element> stack(&frame_res);
+            stack.reserve(inline_frames);
+            auto take=[&](Element &c){
+                if(c.tag()==TAG_ARR){
+                    for(Element &e:*c.u.arr){
+                        if(e.has_children())stack.push_back(std::move(e));
+                    }
+                }else{
+                    for(auto &kv:*c.u.obj){
+                        if(kv.second.has_children())stack.push_back(std::move(kv.second));
+                    }
                 }
-                if(!s.empty())s+=trailing_quote?",\n":"\n";
-                s;
-            })+indent(depth)+"]";
-        }else if(std::holds_alternative<std::map<std::string,Element>>(data)){//object
-            return "{\n"+({
-                std::string s;
-                bool first=true;
-                for(auto &e:get_obj()){
-                    if(!first)s+=",\n";
-                    s+=indent(depth+1);
-                    s+=quote_str(e.first);
-                    s+=" : ";
-                    s+=e.second.to_json(trailing_quote,depth+1);
-                    first=false;
+            };
+            take(*this);
+            while(!stack.empty()){
+                Element c=std::move(stack.back());
+                stack.pop_back();
+                take(c);
+            }//'c' has nothing nested left, so destroying it doesn't come back here
+        }
+        if(tag()==TAG_ARR){
+            delete_box(u.arr);
+        }else{
+            delete_box(u.obj);
+        }
+    }
+    
+    Element parse(std::string_view data,std::pmr::memory_resource * res,size_t max_depth){
+        size_t i=0;
+        return get_element(data,i,{nullptr,res,max_depth,nullptr});
+    }
+    
+    Element parse_insitu(char * data,size_t len,std::pmr::memory_resource * res,size_t max_depth){
+        size_t i=0;
+        return get_element(std::string_view(data,len),i,{data,res,max_depth,nullptr});
+    }
+    
+    Element parse_parallel(std::string_view data,size_t threads,std::pmr::memory_resource * res,size_t max_depth){
+        if(threads==0)threads=std::max(std::thread::hardware_concurrency(),1U);
+        size_t i=0;
+        skip_whitespace(data,i);
+        if(threads<2||data.size()<parallel_min_size||max_depth==0||!is_char(data,i,'[')) return parse(data,res,max_depth);
+        
+        //find where every element starts, anything the scan doesn't accept is left to the serial parser, so that errors are the same
+        std::vector<size_t> starts;
+        try{
+            i++;
+            skip_whitespace(data,i);
+            while(!is_char(data,i,']')){
+                starts.push_back(i);
+                skip_element(data,i);
+                skip_whitespace(data,i);
+                if(is_char(data,i,']'))break;
+                expect_char(data,i,',');
+                i++;
+                skip_whitespace(data,i);
+            }
+        }catch(std::runtime_error &){
+            return parse(data,res,max_depth);
+        }
+        const size_t end=i;
+        if(starts.size()<2) return parse(data,res,max_depth);
+        
+        array_t arr(res);
+        arr.reserve(starts.size());
+        for(size_t k=0;k<starts.size();k++){
+            arr.emplace_back(JSON_NULL);
+        }
+        
+        //every thread gets a contiguous run of elements covering about the same number of bytes
+        threads=std::min(threads,starts.size());
+        std::vector<size_t> first(threads+1,starts.size());
+        for(size_t t=0,k=0;t<threads;t++){
+            size_t target=starts.empty()?0:starts[0]+(end-starts[0])*t/threads;
+            while(k<starts.size()&&starts[k]<target)k++;
+            first[t]=k;
+        }
+        
+        std::vector<std::exception_ptr> errors(threads);
+        auto work=[&](size_t t){
+            try{
+                for(size_t k=first[t];k<first[t+1];k++){
+                    size_t j=starts[k];
+                    arr[k]=get_element(data,j,{nullptr,res,max_depth,nullptr,1});//inside the top-level array
                 }
-                if(!s.empty())s+=trailing_quote?",\n":"\n";
-                s;
-            })+indent(depth)+"}";
+            }catch(...){
+                errors[t]=std::current_exception();
+            }
+        };
+        Util::parallel_for(threads,[&](size_t begin,size_t end){
+            for(size_t t=begin;t<end;t++){
+                work(t);
+            }
+        });
+        
+        //each thread stopped at its first error, so the one of the earliest thread is the first in the document, same as parse()
+        for(std::exception_ptr &e:errors){
+            if(e)std::rethrow_exception(e);
         }
-        __builtin_unreachable();//all std::variant cases are handled in the if/else, this is absolutely unreachable
+        return JSON::Array(std::move(arr));
     }
     
-    std::string Element::to_json_min() const {
-        if(std::holds_alternative<int64_t>(data)){//int
-            return std::to_string(get_int());
-        }else if(std::holds_alternative<double>(data)){//double
-            return std::to_string(get_double());
-        }else if(std::holds_alternative<std::string>(data)){//string
-            return quote_str(get_str());
-        }else if(std::holds_alternative<JSON_Literal>(data)){//literal
-            return std::get<JSON_Literal>(data)==JSON_TRUE?"true":std::get<JSON_Literal>(data)==JSON_FALSE?"false":"null";
-        }else if(std::holds_alternative<std::vector<Element>>(data)){//array
-            return "["+({
-                std::string s;
-                bool first=true;
-                for(auto &e:get_arr()){
-                    if(!first)s+=",";
-                    s+=e.to_json_min();
-                    first=false;
+    Query::Query(const std::vector<std::string> &paths) : nodes(1) {
+        for(const std::string &path:paths){
+            add(path);
+        }
+    }
+    
+    void Query::add(std::string_view path){
+        if(!path.empty()&&path[0]!='/') throw JSON_Exception("Invalid JSON Pointer "+Util::quote_str_single(std::string(path)));
+        size_t node=0;
+        while(!path.empty()){
+            path.remove_prefix(1);
+            size_t end=path.find('/');
+            std::string_view segment=path.substr(0,end);
+            path.remove_prefix(segment.size());
+            size_t next;
+            if(segment=="*"){
+                next=nodes[node].any;
+                if(next==npos){
+                    next=nodes.size();
+                    nodes[node].any=next;
+                    nodes.emplace_back();
                 }
-                s;
-            })+"]";
-        }else if(std::holds_alternative<std::map<std::string,Element>>(data)){//object
-            return "{"+({
-                std::string s;
-                bool first=true;
-                for(auto &e:get_obj()){
-                    if(!first)s+=",";
-                    s+=quote_str(e.first);
-                    s+=":";
-                    s+=e.second.to_json_min();
-                    first=false;
+            }else{
+                std::string key;
+                for(size_t i=0;i<segment.size();i++){
+                    if(segment[i]=='~'&&i+1<segment.size()&&(segment[i+1]=='0'||segment[i+1]=='1')){
+                        key+=segment[++i]=='0'?'~':'/';
+                    }else{
+                        key+=segment[i];
+                    }
+                }
+                next=npos;
+                for(auto &c:nodes[node].children){
+                    if(c.first==key){
+                        next=c.second;
+                        break;
+                    }
                 }
-                s;
-            })+"}";
+                if(next==npos){
+                    next=nodes.size();
+                    nodes[node].children.emplace_back(std::move(key),next);
+                    nodes.emplace_back();
+                }
+            }
+            node=next;
+        }
+        nodes[node].match=true;
+    }
+    
+    size_t Query::child(size_t node,std::string_view key) const {
+        for(auto &c:nodes[node].children){
+            if(c.first==key) return c.second;
         }
-        __builtin_unreachable();//all std::variant cases are handled in the if/else, this is absolutely unreachable
+        return nodes[node].any;
     }
     
-    Element parse(const std::string &data){
+    size_t Query::child(size_t node,size_t index) const {
+        if(nodes[node].children.empty()) return nodes[node].any;
+        char buf[24];
+        return child(node,std::string_view(buf,std::to_chars(buf,buf+sizeof(buf),index).ptr-buf));
+    }
+    
+    Element Query::parse(std::string_view data,std::pmr::memory_resource * res) const {
         size_t i=0;
-        return get_element(data,i);
+        std::optional<Element> e=select_element(data,i,{nullptr,res,default_max_depth,nullptr},*this,0);
+        return e?std::move(*e):Element(JSON_NULL);
+    }
+    
+    void * Document::upstream_resource::do_allocate(size_t bytes,size_t alignment){
+        void * p=std::pmr::new_delete_resource()->allocate(bytes,alignment);
+        allocated+=bytes;
+        return p;
+    }
+    
+    void Document::upstream_resource::do_deallocate(void * p,size_t bytes,size_t alignment){
+        std::pmr::new_delete_resource()->deallocate(p,bytes,alignment);
+    }
+    
+    bool Document::upstream_resource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+        return this==&other;
+    }
+    
+    Document::Document(size_t initial_size) : block(new std::byte[initial_size]),block_size(initial_size),root(nullptr) {
+        clear();
+    }
+    
+    Document::~Document(){
+        strings.reset();
+        arena.reset();//the tree is never destroyed, the arena going away frees it
+    }
+    
+    void Document::clear(){
+        size_t max_value_size=strings?strings->max_value_size:0;
+        strings.reset();//its table is in the arena
+        arena.reset();
+        if(upstream.allocated>0){//previous document didn't fit the first block, grow it so the next one does
+            block_size+=upstream.allocated;
+            block.reset(new std::byte[block_size]);
+            upstream.allocated=0;
+        }
+        arena.emplace(block.get(),block_size,&upstream);
+        strings.emplace(&*arena,max_value_size);
+        set_root(Element(JSON_NULL));
+    }
+    
+    Element& Document::set_root(Element &&e){
+        root=new(arena->allocate(sizeof(Element),alignof(Element))) Element(std::move(e));
+        return *root;
+    }
+    
+    Element& Document::parse(std::string_view data){
+        clear();
+        size_t i=0;
+        return set_root(get_element(data,i,{nullptr,get_resource(),default_max_depth,&*strings}));
+    }
+    
+    Element& Document::parse_insitu(char * data,size_t len){
+        clear();
+        size_t i=0;
+        return set_root(get_element(std::string_view(data,len),i,{data,get_resource(),default_max_depth,&*strings}));
+    }
+    
+    Interner::Interner(std::pmr::memory_resource * r,size_t m) : max_value_size(m), res(r), strings(r) {
+    }
+    
+    Interner::~Interner(){
+        clear();
+    }
+    
+    std::string_view Interner::intern(std::string_view s){
+        if(s.empty()) return std::string_view("",0);
+        auto it=strings.find(s);
+        if(it!=strings.end()) return *it;
+        char * p=static_cast<char*>(res->allocate(s.size(),1));
+        memcpy(p,s.data(),s.size());
+        return *strings.emplace(p,s.size()).first;
+    }
+    
+    void Interner::clear(){
+        for(std::string_view s:strings){
+            res->deallocate(const_cast<char*>(s.data()),s.size(),1);
+        }
+        strings.clear();
     }
     
 }
@@ -17,11 +17,24 @@
 
 #include <variant>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <memory_resource>
+#include <unordered_set>
 #include <cstdint>
+#include <limits>
+#include <cstring>
+#include <new>
 #include <stdexcept>
 #include <optional>
+#include <iterator>
+#include <iosfwd>
+#include <memory>
+#include <functional>
 
 
 #include "util.h"
@@ -33,9 +46,240 @@ enum JSON_Literal {
 };
 
 namespace JSON {
+    
+    //map stored as a vector sorted by key, small maps are searched linearly, bigger ones with a binary search
+    //keys can be looked up with anything convertible to std::string_view, iteration goes in key order like std::map
+    template<typename K,typename V>
+    class FlatMap {
+        public:
+            using key_type=K;
+            using mapped_type=V;
+            using value_type=std::pair<K,V>;
+            using container_type=std::pmr::vector<value_type>;
+            using allocator_type=typename container_type::allocator_type;
+            using iterator=typename container_type::iterator;
+            using const_iterator=typename container_type::const_iterator;
+            using size_type=size_t;
+            
+            FlatMap()=default;
+            explicit FlatMap(const allocator_type &alloc) : v(alloc) {}
+            
+            inline iterator begin() noexcept { return v.begin(); }
+            inline iterator end() noexcept { return v.end(); }
+            inline const_iterator begin() const noexcept { return v.begin(); }
+            inline const_iterator end() const noexcept { return v.end(); }
+            inline const_iterator cbegin() const noexcept { return v.cbegin(); }
+            inline const_iterator cend() const noexcept { return v.cend(); }
+            
+            inline size_type size() const noexcept { return v.size(); }
+            inline bool empty() const noexcept { return v.empty(); }
+            inline void clear() noexcept { v.clear(); }
+            inline void reserve(size_type n){ v.reserve(n); }
+            inline allocator_type get_allocator() const noexcept { return v.get_allocator(); }
+            
+            iterator find(std::string_view key){
+                return v.begin()+(static_cast<const FlatMap*>(this)->find(key)-v.cbegin());
+            }
+            
+            const_iterator find(std::string_view key) const {
+                if(v.size()<=linear_max){
+                    for(auto it=v.begin();it!=v.end();++it){
+                        const std::string_view k(it->first);
+                        if((k.data()==key.data()&&k.size()==key.size())||k==key) return it;//interned keys match by address
+                    }
+                    return v.end();
+                }
+                auto it=lower_bound(key);
+                return (it!=v.end()&&std::string_view(it->first)==key)?it:v.end();
+            }
+            
+            inline size_type count(std::string_view key) const { return find(key)!=v.end(); }
+            
+            V& at(std::string_view key){
+                auto it=find(key);
+                return it!=v.end()?it->second:throw std::out_of_range("FlatMap::at");
+            }
+            
+            const V& at(std::string_view key) const {
+                auto it=find(key);
+                return it!=v.end()?it->second:throw std::out_of_range("FlatMap::at");
+            }
+            
+            //like std::map::try_emplace, nothing is constructed from 'args' if the key is already there
+            //there's no operator[], it would need a default constructible V, which Element isn't
+            template<typename KK,typename ... Args>
+            std::pair<iterator,bool> emplace(KK &&key,Args && ... args){
+                std::string_view k(key);
+                auto it=lower_bound(k);
+                if(it!=v.end()&&std::string_view(it->first)==k) return {v.begin()+(it-v.cbegin()),false};
+                return {v.emplace(it,std::piecewise_construct,std::forward_as_tuple(std::forward<KK>(key)),std::forward_as_tuple(std::forward<Args>(args)...)),true};
+            }
+            
+            inline std::pair<iterator,bool> insert(const value_type &kv){ return emplace(kv.first,kv.second); }
+            inline std::pair<iterator,bool> insert(value_type &&kv){ return emplace(std::move(kv.first),std::move(kv.second)); }
+            
+            inline iterator erase(const_iterator it){ return v.erase(it); }
+            
+            size_type erase(std::string_view key){
+                auto it=find(key);
+                if(it==v.end()) return 0;
+                v.erase(it);
+                return 1;
+            }
+            
+            //appends without keeping the order, sort() must be called before doing anything else with the map
+            template<typename KK,typename ... Args>
+            V& emplace_unsorted(KK &&key,Args && ... args){
+                return v.emplace_back(std::piecewise_construct,std::forward_as_tuple(std::forward<KK>(key)),std::forward_as_tuple(std::forward<Args>(args)...)).second;
+            }
+            
+            //restores the order after emplace_unsorted, only the first of any duplicate keys is kept, same as inserting them one by one
+            void sort(){
+                auto less=[](const value_type &a,const value_type &b){ return std::string_view(a.first)<std::string_view(b.first); };
+                if(v.size()<=insertion_sort_max){
+                    //also stable, and unlike std::stable_sort it doesn't allocate a temporary buffer
+                    for(auto it=v.begin();it!=v.end();++it){
+                        std::rotate(std::upper_bound(v.begin(),it,*it,less),it,it+1);
+                    }
+                }else{
+                    std::stable_sort(v.begin(),v.end(),less);
+                }
+                v.erase(std::unique(v.begin(),v.end(),[](const value_type &a,const value_type &b){ return std::string_view(a.first)==std::string_view(b.first); }),v.end());
+            }
+            
+        private:
+            static constexpr size_type linear_max=8;
+            static constexpr size_type insertion_sort_max=32;
+            
+            const_iterator lower_bound(std::string_view key) const {
+                return std::lower_bound(v.begin(),v.end(),key,[](const value_type &a,std::string_view k){ return std::string_view(a.first)<k; });
+            }
+            
+            container_type v;
+    };
+    
+    //object key, either an owned copy allocated from the map's memory resource, or a view of a string kept alive elsewhere, such as by an Interner
+    //reads like a std::string_view, short keys are stored inline, copies are always owned, moving a view keeps it a view
+    class Key {
+        public:
+            using allocator_type=std::pmr::polymorphic_allocator<char>;
+            
+            static constexpr size_t inline_size=12;
+            
+            Key() noexcept : ptr(buf), res(nullptr), len(0) {}
+            Key(std::string_view s,const allocator_type &alloc=allocator_type()) : Key() { assign(s,alloc.resource()); }
+            Key(const Key &other,const allocator_type &alloc=allocator_type()) : Key(std::string_view(other),alloc) {}
+            Key(Key &&other) noexcept : Key() { take(other); }
+            
+            //owned keys from a different resource are copied into 'alloc'
+            Key(Key &&other,const allocator_type &alloc) : Key(std::move(other)) {
+                if(res&&res!=alloc.resource()&&!res->is_equal(*alloc.resource())) assign(*this,alloc.resource());
+            }
+            
+            ~Key(){ free(); }
+            
+            //a key that doesn't own 's', it must outlive the key and any moves of it
+            static inline Key view(std::string_view s) noexcept {
+                Key k;
+                k.ptr=s.data();
+                k.len=uint32_t(s.size());
+                return k;
+            }
+            
+            Key& operator=(Key &&other) noexcept {
+                if(this!=&other){
+                    free();
+                    take(other);
+                }
+                return *this;
+            }
+            
+            Key& operator=(const Key &other){
+                if(this!=&other) assign(other,res?res:std::pmr::get_default_resource());
+                return *this;
+            }
+            
+            inline operator std::string_view() const noexcept { return std::string_view(ptr,len); }
+            inline const char * data() const noexcept { return ptr; }
+            inline size_t size() const noexcept { return len; }
+            inline bool empty() const noexcept { return len==0; }
+            inline bool is_view() const noexcept { return !res&&ptr!=buf; }
+            
+            friend inline bool operator==(const Key &a,std::string_view b) noexcept { return std::string_view(a)==b; }
+            friend inline bool operator!=(const Key &a,std::string_view b) noexcept { return std::string_view(a)!=b; }
+            
+        private:
+            void assign(std::string_view s,std::pmr::memory_resource * r){
+                if(s.size()>UINT32_MAX) throw std::length_error("JSON::Key too long");
+                if(s.size()<=inline_size){
+                    std::char_traits<char>::move(buf,s.data(),s.size());//'s' may be this key's own inline buffer
+                    free();
+                    ptr=buf;
+                    res=nullptr;
+                }else{
+                    char * p=static_cast<char*>(r->allocate(s.size(),1));
+                    std::char_traits<char>::copy(p,s.data(),s.size());
+                    free();
+                    ptr=p;
+                    res=r;
+                }
+                len=uint32_t(s.size());
+            }
+            
+            void take(Key &other) noexcept {
+                if(other.ptr==other.buf){
+                    std::char_traits<char>::copy(buf,other.buf,other.len);
+                    ptr=buf;
+                }else{
+                    ptr=other.ptr;
+                }
+                res=other.res;
+                len=other.len;
+                other.ptr=other.buf;
+                other.res=nullptr;
+                other.len=0;
+            }
+            
+            void free() noexcept {
+                if(res) res->deallocate(const_cast<char*>(ptr),len,1);
+            }
+            
+            const char * ptr;
+            std::pmr::memory_resource * res;//resource 'ptr' was allocated from, null for views and inline keys
+            uint32_t len;
+            char buf[inline_size];
+    };
+    
+    //stores every distinct string once, the views it returns stay valid until it's cleared or destroyed
+    //used by Document and ElementBuilder to share the storage of repeated object keys that are too long to be stored inline, and optionally of short string values
+    class Interner {
+        public:
+            explicit Interner(std::pmr::memory_resource * res=std::pmr::get_default_resource(),size_t max_value_size=0);
+            ~Interner();
+            
+            Interner(const Interner &)=delete;
+            Interner& operator=(const Interner &)=delete;
+            
+            std::string_view intern(std::string_view s);
+            
+            void clear();
+            
+            inline size_t size() const { return strings.size(); }
+            
+            //string values up to this long are interned too, and stored as string views, unless they're short enough to be stored inline, 0 only interns keys
+            //like with parse_insitu, non-const get_str() copies them into a string_t the first time it's called, const access doesn't
+            size_t max_value_size;
+            
+        private:
+            std::pmr::memory_resource * res;
+            std::pmr::unordered_set<std::string_view> strings;
+    };
+    
     class Element;
-    using object_t=std::map<std::string,Element>;
-    using array_t=std::vector<Element>;
+    //all containers use polymorphic allocators so that whole documents can be allocated from a single arena, see JSON::Document
+    using string_t=std::pmr::string;
+    using object_t=FlatMap<Key,Element>;
+    using array_t=std::pmr::vector<Element>;
     
     inline std::string json_except_format(const std::string &pre,const std::string &expected,const std::string &is){
         return pre+"Expected type "+Util::quote_str_single(expected)+", got type "+Util::quote_str_single(is);
@@ -65,70 +309,163 @@ namespace JSON {
             JSON_Exception(json_except_format(expected,is)){}
     };
     
+    //16 bytes, an 8 byte payload and the type in the last byte, so arrays of elements stay dense
+    //strings of up to short_size bytes are stored inline, longer strings and containers are allocated separately, from the same memory resource as their contents
     class Element {
         public:
+            static constexpr size_t short_size=14;
             
-            using data_t = std::variant<int64_t,double,std::string,array_t,object_t,JSON_Literal>;
-            data_t data;
+            //conversion constructors for simple data types
+            inline Element(int i) noexcept : Element(int64_t(i)) {}
+            inline Element(int64_t i) noexcept { u.i=i; set_tag(TAG_INT); }
+            inline Element(double d) noexcept { u.d=d; set_tag(TAG_DOUBLE); }
+            inline Element(const char * s) : Element(copy(s,std::pmr::get_default_resource())) {}
+            inline Element(const std::string &s) : Element(copy(s,std::pmr::get_default_resource())) {}
+            inline Element(const string_t &s) : Element(copy(s,std::pmr::get_default_resource())) {}
+            inline Element(string_t &&s){ if(s.size()<=short_size) set_short(s); else set_box(TAG_STR,u.str,std::move(s)); }
+            inline Element(array_t &&v){ set_box(TAG_ARR,u.arr,std::move(v)); }
+            inline Element(object_t &&m){ set_box(TAG_OBJ,u.obj,std::move(m)); }
+            inline Element(bool b) noexcept : Element(b?JSON_TRUE:JSON_FALSE) {}
+            inline Element(std::nullptr_t) noexcept : Element(JSON_NULL) {}
+            inline Element(JSON_Literal l) noexcept { u.literal=l; set_tag(TAG_LITERAL); }
             
-            //explicit constructors using std::variant
-            explicit inline Element(const data_t & v) : data(v) {}
-            explicit inline Element(data_t && v) : data(std::move(v)) {}
+            //copies own everything they hold, allocated from the default resource, except string views, which stay views
+            //copying, destroying and writing trees doesn't recurse, so they can be nested as deep as the parsers allow
+            Element(const Element &other) : u(other.u) {
+                switch(tag()){
+                case TAG_STR_COPY:
+                    set_copy(other.get_str_view(),std::pmr::get_default_resource());
+                    break;
+                case TAG_STR:
+                    set_box(TAG_STR,u.str,string_t(*other.u.str));
+                    break;
+                case TAG_ARR:
+                case TAG_OBJ:
+                    copy_tree(other);
+                    break;
+                default:
+                    break;
+                }
+            }
             
-            //conversion constructors for simple data types
-            inline Element(int i) : data(i) {}
-            inline Element(int64_t i) : data(i) {}
-            inline Element(double d) : data(d) {}
-            inline Element(const std::string &s) : data(s) {}
-            inline Element(std::string &&s) : data(std::move(s)) {}
-            inline Element(bool b) : data(b?JSON_TRUE:JSON_FALSE) {}
-            inline Element(std::nullptr_t) : data(JSON_NULL) {}
-            inline Element(JSON_Literal l) : data(l) {}
+            //the moved from element is left null
+            Element(Element &&other) noexcept : u(other.u) {
+                other.u.literal=JSON_NULL;
+                other.set_tag(TAG_LITERAL);
+            }
+            
+            Element& operator=(const Element &other){
+                if(this!=&other) *this=Element(other);
+                return *this;
+            }
             
-            //helper access methods, may throw std::bad_variant_access if trying to access wrong types
-            inline int64_t& get_int(){ return is_int()?std::get<int64_t>(data):throw JSON_Exception("Integer",type_name()); }
-            inline const int64_t& get_int() const { return is_int()?std::get<int64_t>(data):throw JSON_Exception("Integer",type_name()); }
+            Element& operator=(Element &&other) noexcept {
+                if(this!=&other){
+                    free();
+                    u=other.u;
+                    other.u.literal=JSON_NULL;
+                    other.set_tag(TAG_LITERAL);
+                }
+                return *this;
+            }
+            
+            ~Element(){ free(); }
+            
+            //an element that doesn't own 's', it must outlive the element and any moves of it, see StringView
+            static inline Element view(std::string_view s){
+                if(s.size()>UINT32_MAX) throw std::length_error("JSON::Element string view too long");
+                Element e(JSON_NULL);
+                e.set_chars(TAG_STR_VIEW,s.data(),s.size());
+                return e;
+            }
+            
+            //a copy of 's' allocated from 'res' in a single block, see String
+            static inline Element copy(std::string_view s,std::pmr::memory_resource * res){
+                Element e(JSON_NULL);
+                if(s.size()<=short_size){
+                    e.set_short(s);
+                }else if(s.size()>UINT32_MAX){
+                    e.set_box(TAG_STR,e.u.str,string_t(s,res));
+                }else{
+                    e.set_copy(s,res);
+                }
+                return e;
+            }
+            
+            //helper access methods, throw JSON_Exception if trying to access wrong types
+            inline int64_t& get_int(){ return is_int()?u.i:throw JSON_Exception("Integer",type_name()); }
+            inline const int64_t& get_int() const { return is_int()?u.i:throw JSON_Exception("Integer",type_name()); }
             
-            inline double& get_double(){ return is_double()?std::get<double>(data):throw JSON_Exception("Double",type_name()); }
-            inline const double& get_double() const { return is_double()?std::get<double>(data):throw JSON_Exception("Double",type_name()); }
+            inline double& get_double(){ return is_double()?u.d:throw JSON_Exception("Double",type_name()); }
+            inline const double& get_double() const { return is_double()?u.d:throw JSON_Exception("Double",type_name()); }
             
-            inline int64_t get_number_int() const { return is_double()?static_cast<int64_t>(std::get<double>(data)):is_int()?std::get<int64_t>(data):throw JSON_Exception("Number",type_name()); }
-            inline double get_number_double() const { return is_double()?std::get<double>(data):is_int()?static_cast<double>(std::get<int64_t>(data)):throw JSON_Exception("Number",type_name()); }
+            inline int64_t get_number_int() const { return is_double()?static_cast<int64_t>(u.d):is_int()?u.i:throw JSON_Exception("Number",type_name()); }
+            inline double get_number_double() const { return is_double()?u.d:is_int()?static_cast<double>(u.i):throw JSON_Exception("Number",type_name()); }
             
-            inline std::string& get_str(){ return is_str()?std::get<std::string>(data):throw JSON_Exception("String",type_name()); }
-            inline const std::string& get_str() const { return is_str()?std::get<std::string>(data):throw JSON_Exception("String",type_name()); }
+            //other strings are converted into a string_t on non-const access, const access never converts and works for every kind of string, like get_str_view()
+            //copies keep their memory resource, inline strings and string views use the default one
+            inline string_t& get_str(){
+                if(tag()==TAG_SHORT_STR||tag()==TAG_STR_VIEW||tag()==TAG_STR_COPY){
+                    string_t * s;
+                    new_box(s,string_t(get_str_view(),tag()==TAG_STR_COPY?copy_resource():std::pmr::get_default_resource()));
+                    free();
+                    u.str=s;
+                    set_tag(TAG_STR);
+                }
+                return tag()==TAG_STR?*u.str:throw JSON_Exception("String",type_name());
+            }
+            inline std::string_view get_str() const { return get_str_view(); }
+            
+            //works for every kind of string
+            inline std::string_view get_str_view() const {
+                switch(tag()){
+                case TAG_SHORT_STR:
+                    return std::string_view(u.bytes,uint8_t(u.bytes[short_size]));
+                case TAG_STR_VIEW:
+                case TAG_STR_COPY:
+                    return std::string_view(u.chars,chars_size());
+                case TAG_STR:
+                    return *u.str;
+                default:
+                    throw JSON_Exception("String",type_name());
+                }
+            }
             
-            inline array_t& get_arr(){ return is_arr()?std::get<array_t>(data):throw JSON_Exception("Array",type_name()); }
-            inline const array_t& get_arr() const { return is_arr()?std::get<array_t>(data):throw JSON_Exception("Array",type_name()); }
+            inline array_t& get_arr(){ return is_arr()?*u.arr:throw JSON_Exception("Array",type_name()); }
+            inline const array_t& get_arr() const { return is_arr()?*u.arr:throw JSON_Exception("Array",type_name()); }
             
-            inline object_t& get_obj(){ return is_obj()?std::get<object_t>(data):throw JSON_Exception("Object",type_name()); }
-            inline const object_t& get_obj() const { return is_obj()?std::get<object_t>(data):throw JSON_Exception("Object",type_name()); }
+            inline object_t& get_obj(){ return is_obj()?*u.obj:throw JSON_Exception("Object",type_name()); }
+            inline const object_t& get_obj() const { return is_obj()?*u.obj:throw JSON_Exception("Object",type_name()); }
             
-            inline bool get_bool() const { return std::holds_alternative<JSON_Literal>(data)?(std::get<JSON_Literal>(data)!=JSON_NULL?std::get<JSON_Literal>(data)==JSON_TRUE:throw JSON_Exception("Boolean",type_name())):throw JSON_Exception("Boolean",type_name()); }
+            inline bool get_bool() const { return is_bool()?u.literal==JSON_TRUE:throw JSON_Exception("Boolean",type_name()); }
             
             //helper type check methods
             
-            inline bool is_int() const { return std::holds_alternative<int64_t>(data); }
+            inline bool is_int() const { return tag()==TAG_INT; }
             
-            inline bool is_double() const { return std::holds_alternative<double>(data); }
+            inline bool is_double() const { return tag()==TAG_DOUBLE; }
             
-            inline bool is_number() const { return std::holds_alternative<int64_t>(data)||std::holds_alternative<double>(data); }
+            inline bool is_number() const { return tag()==TAG_INT||tag()==TAG_DOUBLE; }
             
-            inline bool is_str() const { return std::holds_alternative<std::string>(data); }
+            inline bool is_str() const { return tag()==TAG_SHORT_STR||tag()==TAG_STR_VIEW||tag()==TAG_STR_COPY||tag()==TAG_STR; }
             
-            inline bool is_arr() const { return std::holds_alternative<std::vector<Element>>(data); }
+            inline bool is_str_view() const { return tag()==TAG_STR_VIEW; }
             
-            inline bool is_obj() const { return std::holds_alternative<std::map<std::string,Element>>(data); }
+            inline bool is_arr() const { return tag()==TAG_ARR; }
             
-            inline bool is_bool() const { return std::holds_alternative<JSON_Literal>(data)&&std::get<JSON_Literal>(data)!=JSON_NULL; }
+            inline bool is_obj() const { return tag()==TAG_OBJ; }
             
-            inline bool is_null() const { return std::holds_alternative<JSON_Literal>(data)&&std::get<JSON_Literal>(data)==JSON_NULL; }
+            inline bool is_bool() const { return tag()==TAG_LITERAL&&u.literal!=JSON_NULL; }
+            
+            inline bool is_null() const { return tag()==TAG_LITERAL&&u.literal==JSON_NULL; }
             
             inline const char * type_name() const {
                 if(is_int()){
                     return "Integer";
                 }else if(is_double()){
                     return "Double";
+                }else if(is_str_view()){
+                    return "String View";
                 }else if(is_str()){
                     return "String";
                 }else if(is_arr()){
@@ -144,7 +481,7 @@ namespace JSON {
                 }
             }
             
-            //serialize with spaces/newlines
+            //serialize with spaces/newlines, see JSON::Writer to serialize into an existing buffer or a stream
             std::string to_json(bool trailing_quote=true,size_t depth=0) const;
             
             //serialize without spaces/newlines
@@ -154,40 +491,854 @@ namespace JSON {
                 return get_arr().at(index);
             }
             
-            Element& operator[](const char * index){//object access
-                return get_obj().at(index);
+            const Element& operator[](size_t index) const {
+                return get_arr().at(index);
             }
             
-            Element& operator[](std::string index){//object access
-                return get_obj().at(index);
+            //the const char * overloads are there so literals don't go through the implicit conversion to int64_t and the built-in operator[] instead
+            Element& operator[](const char * key){//object access
+                return get_obj().at(key);
             }
             
-            operator int64_t(){
+            const Element& operator[](const char * key) const {
+                return get_obj().at(key);
+            }
+            
+            Element& operator[](std::string_view key){
+                return get_obj().at(key);
+            }
+            
+            const Element& operator[](std::string_view key) const {
+                return get_obj().at(key);
+            }
+            
+            //number of elements of an array or members of an object
+            inline size_t size() const { return is_arr()?u.arr->size():is_obj()?u.obj->size():throw JSON_Exception(std::vector<std::string>{"Array","Object"},type_name()); }
+            
+            //object lookup that doesn't throw if the key isn't there, null if it isn't or this isn't an object
+            Element * find(std::string_view key){
+                return const_cast<Element*>(static_cast<const Element*>(this)->find(key));
+            }
+            
+            const Element * find(std::string_view key) const {
+                if(!is_obj()) return nullptr;
+                const object_t &obj=*u.obj;
+                auto it=obj.find(key);
+                return it!=obj.end()?&it->second:nullptr;
+            }
+            
+            operator int64_t() const {
                 return is_int()?get_int():is_double()?get_double():throw std::bad_variant_access();
             }
             
-            operator double(){
+            operator double() const {
                 return is_int()?get_int():is_double()?get_double():throw std::bad_variant_access();
             }
             
-            operator std::string(){
-                return is_str()?get_str():throw std::bad_variant_access();
+            operator std::string() const {
+                return is_str()?std::string(get_str_view()):throw std::bad_variant_access();
+            }
+            
+            //doesn't copy, only valid as long as the element is
+            explicit operator std::string_view() const {
+                return get_str_view();
+            }
+            
+        private:
+            enum tag_t : uint8_t {
+                TAG_INT,
+                TAG_DOUBLE,
+                TAG_LITERAL,
+                TAG_SHORT_STR,//the first short_size bytes, with the length in the byte after them
+                TAG_STR_VIEW,//a pointer, with a 32 bit length in the second 8 bytes
+                TAG_STR_COPY,//same, but the chars are owned, and preceded by the resource they were allocated from
+                TAG_STR,//a string_t, only once get_str() needed one
+                TAG_ARR,
+                TAG_OBJ,
+            };
+            
+            //the tag is always the last byte, which none of the other members reach
+            union {
+                int64_t i;
+                double d;
+                JSON_Literal literal;
+                const char * chars;
+                string_t * str;
+                array_t * arr;
+                object_t * obj;
+                char bytes[16];
+            } u;
+            
+            inline tag_t tag() const noexcept { return tag_t(u.bytes[15]); }
+            inline void set_tag(tag_t t) noexcept { u.bytes[15]=char(t); }
+            
+            inline void set_short(std::string_view s) noexcept {
+                std::char_traits<char>::copy(u.bytes,s.data(),s.size());
+                u.bytes[short_size]=char(s.size());
+                set_tag(TAG_SHORT_STR);
+            }
+            
+            inline void set_chars(tag_t t,const char * p,size_t len) noexcept {
+                u.chars=p;
+                uint32_t len32=uint32_t(len);
+                memcpy(u.bytes+8,&len32,sizeof(len32));
+                set_tag(t);
+            }
+            
+            inline uint32_t chars_size() const noexcept {
+                uint32_t len;
+                memcpy(&len,u.bytes+8,sizeof(len));
+                return len;
             }
             
+            inline std::pmr::memory_resource * copy_resource() const noexcept {
+                std::pmr::memory_resource * r;
+                memcpy(&r,u.chars-sizeof(r),sizeof(r));
+                return r;
+            }
+            
+            inline void set_copy(std::string_view s,std::pmr::memory_resource * r){
+                char * p=static_cast<char*>(r->allocate(sizeof(r)+s.size(),alignof(std::pmr::memory_resource*)));
+                memcpy(p,&r,sizeof(r));
+                std::char_traits<char>::copy(p+sizeof(r),s.data(),s.size());
+                set_chars(TAG_STR_COPY,p+sizeof(r),s.size());
+            }
+            
+            //moves 'v' into its own allocation, from the resource it already uses
+            template<typename T>
+            static void new_box(T * &p,T &&v){
+                std::pmr::memory_resource * r=v.get_allocator().resource();
+                p=new(r->allocate(sizeof(T),alignof(T))) T(std::move(v));
+            }
+            
+            template<typename T>
+            static void delete_box(T * p) noexcept {
+                std::pmr::memory_resource * r=p->get_allocator().resource();
+                p->~T();
+                r->deallocate(p,sizeof(T),alignof(T));
+            }
+            
+            template<typename T>
+            inline void set_box(tag_t t,T * &p,T &&v){
+                new_box(p,std::move(v));
+                set_tag(t);
+            }
+            
+            inline bool has_children() const noexcept {
+                return (tag()==TAG_ARR&&!u.arr->empty())||(tag()==TAG_OBJ&&!u.obj->empty());
+            }
+            
+            void copy_tree(const Element &other);
+            void free_container() noexcept;
+            
+            void free() noexcept {
+                switch(tag()){
+                case TAG_STR_COPY:
+                    copy_resource()->deallocate(const_cast<char*>(u.chars)-sizeof(std::pmr::memory_resource*),sizeof(std::pmr::memory_resource*)+chars_size(),alignof(std::pmr::memory_resource*));
+                    break;
+                case TAG_STR:
+                    delete_box(u.str);
+                    break;
+                case TAG_ARR:
+                case TAG_OBJ:
+                    free_container();
+                    break;
+                default:
+                    break;
+                }
+            }
     };
     
+    static_assert(sizeof(Element)==16,"JSON::Element should be 16 bytes");
+    
     inline Element Int(int64_t i){ return Element(i); }
     inline Element Boolean(bool b){ return Element(b?JSON_TRUE:JSON_FALSE); }
     inline Element True(){ return Element(JSON_TRUE); }
     inline Element False(){ return Element(JSON_FALSE); }
     inline Element Null(){ return Element(JSON_NULL); }
     inline Element Double(double d){ return Element(d); }
-    inline Element String(std::string s){ return Element(s); }
-    inline Element Array(const std::vector<Element> & v){ return Element(Element::data_t(v)); }
-    inline Element Array(std::vector<Element> && v){ return Element(Element::data_t(std::move(v))); }
-    inline Element Object(const std::map<std::string,Element> & m){ return Element(Element::data_t(m)); }
-    inline Element Object(std::map<std::string,Element> && m){ return Element(Element::data_t(std::move(m))); }
+    inline Element String(const char * s,std::pmr::memory_resource * res=std::pmr::get_default_resource()){ return Element::copy(s,res); }
+    inline Element String(std::string_view s,std::pmr::memory_resource * res=std::pmr::get_default_resource()){ return Element::copy(s,res); }
+    inline Element String(string_t &&s){ return Element(std::move(s)); }
+    inline Element StringView(std::string_view s){ return Element::view(s); }
+    inline Element Array(const array_t & v){ return Element(array_t(v)); }
+    inline Element Array(array_t && v){ return Element(std::move(v)); }
+    inline Element Object(const object_t & m){ return Element(object_t(m)); }
+    inline Element Object(object_t && m){ return Element(std::move(m)); }
+    
+    //serializes elements by appending to a single buffer, either one supplied by the caller or an internal one that is written out to a stream as it fills up
+    class Writer {
+        public:
+            static constexpr size_t flush_size=64*1024;
+            
+            //pretty output puts every value on its own line, indented by 4 spaces per level, 'trailing_comma' adds a comma after the last value of containers
+            explicit Writer(std::string &out,bool pretty=true,bool trailing_comma=true);
+            explicit Writer(std::ostream &out,bool pretty=true,bool trailing_comma=true);
+            ~Writer();
+            
+            //'depth' is the indentation level the element starts at, for writing into the middle of already indented output
+            void write(const Element &e,size_t depth=0);
+            
+            //writes out buffered data if writing to a stream, does nothing otherwise
+            void flush();
+            
+        private:
+            void write_str(std::string_view s);
+            void newline(size_t depth);
+            
+            std::string own;
+            std::string &buf;
+            std::ostream * stream;
+            bool pretty;
+            bool trailing_comma;
+    };
+    
+    //the parsers don't recurse, so nesting is only limited by this, input with containers nested deeper than 'max_depth' is rejected
+    constexpr size_t default_max_depth=512;
+    
+    //all strings and containers of the returned element are allocated from 'res'
+    Element parse(std::string_view data,std::pmr::memory_resource * res=std::pmr::get_default_resource(),size_t max_depth=default_max_depth);
+    
+    //parses in place, strings and object keys are unescaped inside 'data' and stored as views into it, so it must outlive the returned element
+    Element parse_insitu(char * data,size_t len,std::pmr::memory_resource * res=std::pmr::get_default_resource(),size_t max_depth=default_max_depth);
+    
+    inline Element parse_insitu(std::string &data,std::pmr::memory_resource * res=std::pmr::get_default_resource(),size_t max_depth=default_max_depth){
+        return parse_insitu(data.data(),data.size(),res,max_depth);
+    }
+    
+    constexpr size_t parallel_min_size=256_K;//smaller inputs aren't worth handing out to other threads
+    
+    //parses the elements of a top-level array on Util::ThreadPool::global(), split into 'threads' contiguous runs of them, and anything else serially
+    //gives the same result or error as parse(), 'res' has to be safe to allocate from concurrently, 0 'threads' uses one per core
+    Element parse_parallel(std::string_view data,size_t threads=0,std::pmr::memory_resource * res=std::pmr::get_default_resource(),size_t max_depth=default_max_depth);
+    
+    //a set of paths to extract from a document without building the rest of it
+    //paths use JSON Pointer syntax, with '*' matching any array index or object key, ex. "/assets/*/name"
+    //named segments take precedence over '*' when both match the same key
+    class Query {
+        public:
+            static constexpr size_t npos=-1;
+            
+            explicit Query(const std::vector<std::string> &paths);
+            
+            //only selected values and the containers leading to them are materialized, everything else is skipped over
+            //arrays only keep the elements that had something selected
+            Element parse(std::string_view data,std::pmr::memory_resource * res=std::pmr::get_default_resource()) const;
+            
+            //query node navigation, node 0 is the document root
+            //returns the node for 'key' inside 'node', or npos if nothing inside it is selected
+            size_t child(size_t node,std::string_view key) const;
+            size_t child(size_t node,size_t index) const;
+            
+            //whether the whole value at 'node' is selected
+            inline bool is_match(size_t node) const { return nodes[node].match; }
+            
+        private:
+            void add(std::string_view path);
+            
+            struct node_t {
+                std::vector<std::pair<std::string,size_t>> children;
+                size_t any=npos;//child for '*'
+                bool match=false;
+            };
+            
+            std::vector<node_t> nodes;
+    };
+    
+    //a parsed element tree that lives entirely inside a monotonic arena owned by the document
+    //clearing, reparsing or destroying the document frees the whole tree at once without running any element destructors,
+    //so anything added to the tree must be allocated from get_resource() as well, or it will leak
+    //that includes non-const get_str(), which boxes inline strings and string views from the default resource, read its strings through const access instead
+    //the arena's first block is kept between parses, and grown to fit the largest document parsed so far
+    //object keys too long to be stored inline are interned into get_strings(), so each of them is only stored once per document
+    class Document {
+        public:
+            explicit Document(size_t initial_size=16_K);
+            ~Document();
+            
+            Document(const Document &)=delete;
+            Document& operator=(const Document &)=delete;
+            
+            Element& parse(std::string_view data);
+            Element& parse_insitu(char * data,size_t len);
+            
+            inline Element& parse_insitu(std::string &data){
+                return parse_insitu(data.data(),data.size());
+            }
+            
+            void clear();
+            
+            inline Element& get_root(){ return *root; }
+            inline const Element& get_root() const { return *root; }
+            
+            inline std::pmr::memory_resource * get_resource(){ return &*arena; }
+            
+            //lives in the arena too, and is emptied by clear(), its max_value_size is kept
+            inline Interner& get_strings(){ return *strings; }
+            
+            //for trees built from get_resource() outside of parse, such as with an ElementBuilder
+            Element& set_root(Element &&e);
+            
+        private:
+            //counts how much memory the arena had to request past its first block
+            class upstream_resource : public std::pmr::memory_resource {
+                public:
+                    size_t allocated=0;
+                private:
+                    void * do_allocate(size_t bytes,size_t alignment) override;
+                    void do_deallocate(void * p,size_t bytes,size_t alignment) override;
+                    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+            };
+            
+            upstream_resource upstream;
+            std::unique_ptr<std::byte[]> block;
+            size_t block_size;
+            std::optional<std::pmr::monotonic_buffer_resource> arena;
+            std::optional<Interner> strings;
+            Element * root;
+    };
+    
+    //receives the events of a StreamParser, strings passed to it are only valid for the duration of the call
+    class Handler {
+        public:
+            virtual ~Handler()=default;
+            
+            virtual void begin_object()=0;
+            virtual void end_object()=0;
+            virtual void begin_array()=0;
+            virtual void end_array()=0;
+            
+            virtual void key(std::string_view k)=0;
+            
+            virtual void value(std::string_view s)=0;
+            virtual void value(int64_t i)=0;
+            virtual void value(double d)=0;
+            virtual void value(JSON_Literal l)=0;
+    };
+    
+    //resumable event based parser, accepts the same syntax as parse() and throws the same errors, but can be fed the input one chunk at a time
+    //only the token currently being parsed is buffered, anything after the end of the top-level element is ignored, like parse() does
+    class StreamParser {
+        public:
+            static constexpr size_t initial_depth=32;//container stacks are reserved this deep up front, so most documents don't grow them
+            
+            explicit StreamParser(Handler &handler,size_t max_depth=default_max_depth);
+            
+            void feed(std::string_view data);
+            
+            //throws if the input ended before the top-level element did
+            void finish();
+            
+            void reset();
+            
+            inline bool done() const { return state==STATE_DONE; }
+            
+        private:
+            enum state_t {
+                STATE_VALUE,
+                STATE_ARRAY_VALUE,//value or ']'
+                STATE_ARRAY_NEXT,//',' or ']'
+                STATE_OBJECT_KEY,//key or '}'
+                STATE_OBJECT_COLON,
+                STATE_OBJECT_NEXT,//',' or '}'
+                STATE_DONE,
+            };
+            
+            enum lex_t {
+                LEX_NONE,
+                LEX_STRING,
+                LEX_NUMBER,
+                LEX_LITERAL,
+                LEX_COMMENT_START,//got '/'
+                LEX_LINE_COMMENT,
+                LEX_BLOCK_COMMENT,
+            };
+            
+            size_t feed_token(std::string_view data,size_t i);
+            size_t feed_string(std::string_view data,size_t i);
+            void end_string(std::string_view s);
+            void end_word(const char * next);
+            void end_value();
+            void end_container(char c);
+            [[noreturn]] void unexpected(char c,size_t at);
+            
+            Handler &handler;
+            size_t max_depth;
+            std::vector<char> stack;
+            std::string token;
+            size_t pos;//offset of the current chunk, for error messages
+            size_t token_pos;//where the current token starts, the contents of strings rather than their quote, or where a comment's '/' is
+            state_t state;
+            lex_t lex;
+            bool token_is_key;
+            bool token_escaped;//the string token has escapes or newlines
+            bool escape;
+            bool star;
+    };
+    
+    //builds an element tree out of StreamParser events, duplicate keys keep the first value like parse() does
+    //if a query is given, only the values it selects are built, same as Query::parse
+    //if an interner is given, keys and short values are interned into it as Document::parse does, see Document::get_strings
+    class ElementBuilder : public Handler {
+        public:
+            explicit ElementBuilder(std::pmr::memory_resource * res=std::pmr::get_default_resource(),const Query * query=nullptr,Interner * strings=nullptr);
+            
+            //returns the finished tree and resets the builder
+            Element take();
+            
+            void begin_object() override;
+            void end_object() override;
+            void begin_array() override;
+            void end_array() override;
+            
+            void key(std::string_view k) override;
+            
+            void value(std::string_view s) override;
+            void value(int64_t i) override;
+            void value(double d) override;
+            void value(JSON_Literal l) override;
+            
+        private:
+            struct frame_t {
+                Element * e;
+                size_t node;//query node of the container
+                size_t index;//index of the next array element
+                bool whole;//everything inside the container is kept
+            };
+            
+            //decides whether the next value is built, and which query node it's at
+            bool select(bool container);
+            void add(Element &&e,bool container);
+            
+            std::pmr::memory_resource * res;
+            const Query * query;
+            Interner * strings;
+            std::vector<frame_t> stack;
+            Key pending_key;
+            size_t pending_node;
+            size_t next_node;
+            bool next_whole;
+            size_t skip_depth;//nesting depth inside a container that is being discarded
+            Element root;
+    };
+    
+    //binding JSON straight into structs, without building an element tree
+    //a struct is bound by listing its members in a static constexpr 'json_fields' tuple, ex.
+    //    struct Asset {
+    //        std::string name;
+    //        int64_t size=0;
+    //        static constexpr auto json_fields=std::make_tuple(JSON::field("name",&Asset::name),JSON::field("size",&Asset::size));
+    //    };
+    //members can be strings, numbers, bools, std::vectors of bindable types, or other bound structs
+    
+    template<typename T,typename=void>
+    struct Binding;
+    
+    namespace BindInternal {
+        struct type_t;
+        
+        //a value being bound into, a null type discards the value
+        struct slot_t {
+            void * p;
+            const type_t * type;
+            std::string_view name;//of the field, for error messages
+        };
+        
+        //what a bindable type accepts, null functions for anything it doesn't
+        struct type_t {
+            const char * name;
+            slot_t (*member)(void * p,std::string_view k);//objects, returns a null slot for unknown keys
+            slot_t (*element)(void * p);//arrays, adds the next element
+            void (*str)(void * p,std::string_view s);
+            bool (*integer)(void * p,int64_t i);//false if the value can't be stored exactly
+            bool (*number)(void * p,double d);//same
+            void (*boolean)(void * p,bool b);
+        };
+        
+        template<typename Tuple,size_t... I>
+        constexpr bool unique_names(const Tuple &fields,std::index_sequence<I...>){
+            std::string_view names[]{std::get<I>(fields).name...};
+            for(size_t i=0;i<sizeof...(I);i++){
+                for(size_t j=i+1;j<sizeof...(I);j++){
+                    if(names[i]==names[j])return false;
+                }
+            }
+            return true;
+        }
+    }
+    
+    template<typename T,typename M>
+    struct Field {
+        std::string_view name;
+        M T::* member;
+        
+        inline BindInternal::slot_t slot(T &t) const { return {&(t.*member),&Binding<M>::type,name}; }
+    };
+    
+    template<typename T,typename M>
+    constexpr Field<T,M> field(std::string_view name,M T::* member){
+        return {name,member};
+    }
+    
+    //doubles are only accepted if they're whole numbers in range, so 1.5, 1e999 or 300 for a uint8_t throw instead of being truncated or wrapped
+    template<typename T>
+    struct Binding<T,std::enable_if_t<std::is_integral_v<T>&&!std::is_same_v<T,bool>>> {
+        using limits=std::numeric_limits<T>;
+        
+        //2^digits, the first value past max, exact as a double unlike max itself
+        static constexpr double max_plus_one=static_cast<double>(limits::max()/2+1)*2;
+        
+        static bool integer(void * p,int64_t i){
+            if(i<0?(!limits::is_signed||i<static_cast<int64_t>(limits::min())):static_cast<uint64_t>(i)>static_cast<uint64_t>(limits::max()))return false;
+            *static_cast<T*>(p)=static_cast<T>(i);
+            return true;
+        }
+        static bool number(void * p,double d){
+            //the cast is only defined once the truncated value is known to fit, NaN fails every comparison
+            if(!((limits::is_signed?d>=-max_plus_one:d>-1.0)&&d<max_plus_one))return false;
+            const T v=static_cast<T>(d);
+            if(static_cast<double>(v)!=d)return false;
+            *static_cast<T*>(p)=v;
+            return true;
+        }
+        static constexpr BindInternal::type_t type{"Integer",nullptr,nullptr,nullptr,integer,number,nullptr};
+    };
+    
+    template<typename T>
+    struct Binding<T,std::enable_if_t<std::is_floating_point_v<T>>> {
+        static bool integer(void * p,int64_t i){ *static_cast<T*>(p)=static_cast<T>(i); return true; }
+        static bool number(void * p,double d){ *static_cast<T*>(p)=static_cast<T>(d); return true; }
+        static constexpr BindInternal::type_t type{"Number",nullptr,nullptr,nullptr,integer,number,nullptr};
+    };
+    
+    template<>
+    struct Binding<bool> {
+        static void boolean(void * p,bool b){ *static_cast<bool*>(p)=b; }
+        static constexpr BindInternal::type_t type{"Boolean",nullptr,nullptr,nullptr,nullptr,nullptr,boolean};
+    };
+    
+    template<typename Traits,typename Alloc>
+    struct Binding<std::basic_string<char,Traits,Alloc>> {
+        static void str(void * p,std::string_view s){ static_cast<std::basic_string<char,Traits,Alloc>*>(p)->assign(s.data(),s.size()); }
+        static constexpr BindInternal::type_t type{"String",nullptr,nullptr,str,nullptr,nullptr,nullptr};
+    };
+    
+    template<typename T,typename Alloc>
+    struct Binding<std::vector<T,Alloc>> {
+        static BindInternal::slot_t element(void * p){
+            return {&static_cast<std::vector<T,Alloc>*>(p)->emplace_back(),&Binding<T>::type,{}};
+        }
+        static constexpr BindInternal::type_t type{"Array",nullptr,element,nullptr,nullptr,nullptr,nullptr};
+    };
+    
+    //keys are matched against the field names known at compile time, there's no lookup table built at runtime
+    template<typename T>
+    struct Binding<T,std::void_t<decltype(T::json_fields)>> {
+        using index_t=std::make_index_sequence<std::tuple_size_v<std::remove_const_t<decltype(T::json_fields)>>>;
+        
+        static_assert(BindInternal::unique_names(T::json_fields,index_t()),"json_fields has duplicate names");
+        
+        template<size_t... I>
+        static BindInternal::slot_t find(T &t,std::string_view k,std::index_sequence<I...>){
+            BindInternal::slot_t s{nullptr,nullptr,{}};
+            ((k==std::get<I>(T::json_fields).name&&(s=std::get<I>(T::json_fields).slot(t),true))||...);
+            return s;
+        }
+        
+        static BindInternal::slot_t member(void * p,std::string_view k){ return find(*static_cast<T*>(p),k,index_t()); }
+        static constexpr BindInternal::type_t type{"Object",member,nullptr,nullptr,nullptr,nullptr,nullptr};
+    };
+    
+    //fills a bound struct from StreamParser events, members missing from the input or null in it are left as they are, null array elements are skipped
+    //unknown keys and everything inside them are skipped without allocating, repeated keys are bound again
+    //throws JSON_Exception if a value doesn't have the type of the member it's bound to, or a number doesn't fit in it
+    class Binder : public Handler {
+        public:
+            template<typename T>
+            explicit Binder(T &out) : root{&out,&Binding<T>::type,{}} {
+                stack.reserve(StreamParser::initial_depth);
+                reset();
+            }
+            
+            //binds the next top-level value into the same struct again
+            void reset();
+            
+            void begin_object() override;
+            void end_object() override;
+            void begin_array() override;
+            void end_array() override;
+            
+            void key(std::string_view k) override;
+            
+            void value(std::string_view s) override;
+            void value(int64_t i) override;
+            void value(double d) override;
+            void value(JSON_Literal l) override;
+            
+        private:
+            //the slot the next value goes into, null while skipping
+            BindInternal::slot_t next();
+            void begin(bool array);
+            [[noreturn]] void mismatch(const BindInternal::slot_t &s,const char * got);
+            [[noreturn]] void out_of_range(const BindInternal::slot_t &s,const std::string &value);
+            
+            BindInternal::slot_t root;
+            std::vector<BindInternal::slot_t> stack;
+            BindInternal::slot_t pending;//set by key()
+            size_t skip_depth;
+            bool started;
+    };
+    
+    //binds a whole document into 'out', without building an element tree
+    template<typename T>
+    void bind(std::string_view data,T &out,size_t max_depth=default_max_depth){
+        Binder binder(out);
+        StreamParser parser(binder,max_depth);
+        parser.feed(data);
+        parser.finish();
+    }
+    
+    //binary snapshots of element trees, which can be read in place without parsing or deserializing anything
+    //little endian, every value is a 16 byte node holding a type, a length, and either the value itself or the offset of its data from the start of the snapshot
+    //strings are stored null terminated, array elements as consecutive nodes, and object members as key/value node pairs sorted by key
+    
+    class Snapshot;
+    
+    //read only view of a value inside a snapshot, with the same accessors as Element, as long as they don't return a container
+    //only valid while the snapshot it came from is
+    class SnapshotValue {
+        public:
+            int64_t get_int() const;
+            double get_double() const;
+            int64_t get_number_int() const;
+            double get_number_double() const;
+            std::string_view get_str_view() const;
+            bool get_bool() const;
+            
+            bool is_int() const;
+            bool is_double() const;
+            bool is_number() const;
+            bool is_str() const;
+            bool is_arr() const;
+            bool is_obj() const;
+            bool is_bool() const;
+            bool is_null() const;
+            
+            const char * type_name() const;
+            
+            //number of elements of an array or members of an object
+            size_t size() const;
+            
+            SnapshotValue operator[](size_t index) const;//array access
+            SnapshotValue operator[](std::string_view key) const;//object access
+            
+            //object members in key order, for 'index' up to size()
+            std::string_view key(size_t index) const;
+            SnapshotValue value(size_t index) const;
+            
+            //object lookup that doesn't throw if the key isn't there
+            std::optional<SnapshotValue> find(std::string_view key) const;
+            
+            //copies the value and everything inside it into a regular element tree
+            Element to_element(std::pmr::memory_resource * res=std::pmr::get_default_resource()) const;
+            
+        private:
+            friend class Snapshot;
+            
+            SnapshotValue(const char * base,const char * node) : base(base), node(node) {}
+            
+            unsigned type() const;
+            
+            const char * base;
+            const char * node;
+    };
+    
+    //a snapshot mapped from a file or viewed in memory, checked once when opened, so corrupted files are rejected there instead of being read out of bounds later
+    class Snapshot {
+        public:
+            //maps the file, it's read lazily by the os as values are accessed
+            explicit Snapshot(const std::string &filename);
+            
+            //'data' must outlive the snapshot
+            explicit Snapshot(std::string_view data);
+            
+            SnapshotValue root() const;
+            
+            //serializes 'e', which can be written out with Util::writefile_binary, throws if it's nested deeper than default_max_depth, which opening would reject
+            static std::vector<std::byte> write(const Element &e);
+            
+        private:
+            void validate();
+            
+            std::optional<Util::MappedFile> file;
+            std::string_view data;
+    };
+    
+    //flat parse mode, values are recorded in document order as fixed size nodes in a single vector, instead of being built into a tree
+    //containers store the index of the node after their last descendant, so stepping over a subtree is a single jump
+    //strings and numbers are only checked while parsing, and decoded when they're accessed
+    
+    class Tape;
+    
+    //read only cursor to a value inside a tape, with the same accessors as SnapshotValue
+    //only valid while the tape it came from is, and until it parses something else
+    class TapeValue {
+        public:
+            //steps through the elements of an array or the members of an object in document order, skipping over their contents
+            class iterator {
+                public:
+                    using iterator_category=std::forward_iterator_tag;
+                    using value_type=TapeValue;
+                    using difference_type=std::ptrdiff_t;
+                    using pointer=void;
+                    using reference=TapeValue;
+                    
+                    TapeValue operator*() const;//the element, or the value of the member
+                    std::string_view key() const;//only for object members
+                    
+                    iterator& operator++();
+                    
+                    inline bool operator==(const iterator &other) const { return index==other.index; }
+                    inline bool operator!=(const iterator &other) const { return index!=other.index; }
+                    
+                private:
+                    friend class TapeValue;
+                    
+                    iterator(const Tape * tape,size_t index,bool is_obj) : tape(tape), index(index), is_obj(is_obj) {}
+                    
+                    const Tape * tape;
+                    size_t index;//node of the element, or of the member's key
+                    bool is_obj;
+            };
+            
+            int64_t get_int() const;
+            double get_double() const;
+            int64_t get_number_int() const;
+            double get_number_double() const;
+            std::string_view get_str_view() const;//escaped strings are decoded into the tape the first time they're read
+            bool get_bool() const;
+            
+            bool is_int() const;
+            bool is_double() const;
+            bool is_number() const;
+            bool is_str() const;
+            bool is_arr() const;
+            bool is_obj() const;
+            bool is_bool() const;
+            bool is_null() const;
+            
+            const char * type_name() const;
+            
+            //number of elements of an array or members of an object, duplicate keys included
+            size_t size() const;
+            
+            iterator begin() const;
+            iterator end() const;
+            
+            //these walk the container from the start, so iterate instead of indexing in a loop
+            TapeValue operator[](size_t index) const;//array access
+            TapeValue operator[](std::string_view key) const;//object access
+            
+            //object members in document order, for 'index' up to size()
+            std::string_view key(size_t index) const;
+            TapeValue value(size_t index) const;
+            
+            //object lookup that doesn't throw if the key isn't there, finds the first of any duplicate keys, the one parse() keeps
+            std::optional<TapeValue> find(std::string_view key) const;
+            
+            //decodes the value and everything inside it into a regular element tree
+            Element to_element(std::pmr::memory_resource * res=std::pmr::get_default_resource()) const;
+            
+        private:
+            friend class Tape;
+            
+            TapeValue(const Tape * tape,size_t index) : tape(tape), index(index) {}
+            
+            unsigned type() const;
+            
+            const Tape * tape;
+            size_t index;
+    };
+    
+    //accepts the same input as parse(), the tape only views it, so it must outlive the tape
+    //inputs are limited to 4GB, node positions are stored in 32 bits to keep nodes at 16 bytes
+    //reading escaped strings writes their decoded copies into the tape, so that isn't safe to do from several threads at once
+    class Tape {
+        public:
+            Tape()=default;
+            explicit Tape(std::string_view data,size_t max_depth=default_max_depth);
+            
+            Tape(const Tape &)=delete;
+            Tape& operator=(const Tape &)=delete;
+            
+            //replaces the contents of the tape, reusing its memory
+            void parse(std::string_view data,size_t max_depth=default_max_depth);
+            
+            TapeValue root() const;
+            
+            //number of nodes, every value is one node, including object keys
+            inline size_t size() const { return nodes.size(); }
+            
+        private:
+            friend class TapeValue;
+            
+            struct node_t {
+                uint8_t type;
+                uint32_t len;//length of a string's or number's text, or number of elements/members of a container
+                uint32_t pos;//where the value starts in the input, after the quote for strings
+                mutable uint32_t next;//containers: node after their last descendant, escaped strings: 1 + index of their decoded copy once read, 0 before
+            };
+            
+            //node after the value at 'index' and everything inside it
+            size_t skip(size_t index) const;
+            
+            //contents of the string at 'index', decoding it if needed
+            std::string_view str(size_t index) const;
+            
+            std::string_view data;
+            std::vector<node_t> nodes;
+            std::vector<uint32_t> stack;//containers that are still open while parsing
+            mutable std::vector<std::string_view> decoded;
+            mutable std::pmr::monotonic_buffer_resource decoded_res;
+    };
+    
+    //structural hashes of element trees, equal values hash the same however they were written, such as with different escapes, whitespace or member order
+    //integers and doubles are different types, so 1 and 1.0 don't hash the same, hashes are stable across runs, so they can be kept to compare with a later version of a document
+    
+    //hash of a whole tree, without keeping those of its subtrees
+    uint64_t hash(const Element &e);
+    
+    //the hash of every value in a tree, in the order they're visited, with object members in key order
+    //only valid for the tree it was computed from, as long as that isn't changed
+    class Digest {
+        public:
+            Digest()=default;
+            explicit Digest(const Element &e);
+            
+            //replaces the hashes with those of 'e', reusing the memory
+            void compute(const Element &e);
+            
+            //same as hash(e) of the tree it was computed from, so comparing two roots compares two whole trees
+            inline uint64_t root() const { return nodes.empty()?0:nodes[0].hash; }
+            
+            //number of values in the tree
+            inline size_t size() const { return nodes.size(); }
+            
+        private:
+            friend void diff(const Element &a,const Digest &da,const Element &b,const Digest &db,const std::function<void(const std::string &path,const Element * before,const Element * after)> &changed);
+            
+            struct node_t {
+                uint64_t hash;
+                size_t next;//node after this value's subtree
+            };
+            
+            uint64_t add(const Element &e);
+            
+            std::vector<node_t> nodes;
+    };
     
-    Element parse(const std::string &data);
+    //calls 'changed' with the JSON Pointer of each of the outermost values that differ between 'a' and 'b', subtrees with the same hash aren't visited
+    //'before' is null for values only in 'b', and 'after' for values only in 'a', arrays are compared index by index, so an insertion changes every index after it
+    void diff(const Element &a,const Digest &da,const Element &b,const Digest &db,const std::function<void(const std::string &path,const Element * before,const Element * after)> &changed);
     
 }
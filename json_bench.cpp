@@ -0,0 +1,1206 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+//json parser/serializer benchmark, built by build_bench.sh, doesn't depend on windows
+//usage: json_bench [-t seconds] [-scan scalar|sse2|avx2|all] [-check] [file.json ...]
+//files given on the command line, such as saved github api responses, are benchmarked along with the generated corpus
+//-scan picks the block scanning implementation, all runs everything once with each one the cpu supports, the one actually used is in the scan column
+//-check only checks the allocation budgets of what main.cpp does with a release, that const string access works on parsed trees and strings are written as valid json,
+//that numbers survive a parse/write/parse round trip bit for bit, that written snapshots can be opened, that the stream parser's errors match parse()'s,
+//that trees as deep as max_depth allows can be copied, written and destroyed, that parse_parallel agrees with parse() at the depth limit,
+//that bind rejects numbers that don't fit their members, that the thread pool returns results, cancels and rethrows,
+//that the lazy splitters agree with Util::split and PatternFinder with a pattern by pattern search, that writefile_binary copes with short writes,
+//that ChunkedBuffer reads across its block boundaries, that MappedOutputFile preallocates, truncates on close and never opens an existing file,
+//and exits with 1 if anything fails
+
+#include "json.h"
+#include "json_internal.h"
+#include "util.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <random>
+#include <thread>
+#include <filesystem>
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#endif
+
+//every allocation in the process goes through these, so containers using std::allocator are counted along with pmr ones
+static std::atomic<size_t> alloc_count {0};
+static std::atomic<size_t> alloc_bytes {0};
+static std::atomic<size_t> free_count {0};
+
+static void * counted_alloc(size_t n,size_t align){
+    alloc_count.fetch_add(1,std::memory_order_relaxed);
+    alloc_bytes.fetch_add(n,std::memory_order_relaxed);
+    void * p=align>alignof(std::max_align_t)?std::aligned_alloc(align,(n+align-1)/align*align):std::malloc(n?n:1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+static void counted_free(void * p){
+    if(p)free_count.fetch_add(1,std::memory_order_relaxed);
+    std::free(p);
+}
+
+void * operator new(size_t n){ return counted_alloc(n,0); }
+void * operator new[](size_t n){ return counted_alloc(n,0); }
+void * operator new(size_t n,std::align_val_t a){ return counted_alloc(n,size_t(a)); }
+void * operator new[](size_t n,std::align_val_t a){ return counted_alloc(n,size_t(a)); }
+void operator delete(void * p) noexcept { counted_free(p); }
+void operator delete[](void * p) noexcept { counted_free(p); }
+void operator delete(void * p,size_t) noexcept { counted_free(p); }
+void operator delete[](void * p,size_t) noexcept { counted_free(p); }
+void operator delete(void * p,std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void * p,std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void * p,size_t,std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void * p,size_t,std::align_val_t) noexcept { counted_free(p); }
+
+struct alloc_stats_t {
+    size_t allocs;
+    size_t frees;
+    size_t bytes;
+};
+
+//allocations made by a single run of 'op'
+static alloc_stats_t count_allocs(const std::function<void()> &op){
+    size_t count0=alloc_count.load();
+    size_t frees0=free_count.load();
+    size_t bytes0=alloc_bytes.load();
+    op();
+    return {alloc_count.load()-count0,free_count.load()-frees0,alloc_bytes.load()-bytes0};
+}
+
+//peak resident set size in KB since the last reset, 0 if /proc isn't available
+static size_t peak_rss_kb(){
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while(std::getline(f,line)){
+        if(line.compare(0,6,"VmHWM:")==0) return std::strtoull(line.c_str()+6,nullptr,10);
+    }
+    return 0;
+}
+
+static void reset_peak_rss(){
+    std::ofstream f("/proc/self/clear_refs");
+    f<<"5";
+}
+
+//a file name in the temp directory that no other json_bench run uses
+static std::string temp_path(const char * name){
+    return (std::filesystem::temp_directory_path()/("json_bench_"+std::to_string(std::random_device()())+"_"+name)).string();
+}
+
+namespace Corpus {
+    
+    static std::string user(const std::string &login,int64_t id){
+        std::string u="https://api.github.com/users/"+login;
+        return Util::str_printf(
+            "{\"login\":\"%s\",\"id\":%lld,\"node_id\":\"MDQ6VXNlcjE%lld\",\"avatar_url\":\"https://avatars.githubusercontent.com/u/%lld?v=4\",\"gravatar_id\":\"\","
+            "\"url\":\"%s\",\"html_url\":\"https://github.com/%s\",\"followers_url\":\"%s/followers\",\"following_url\":\"%s/following{/other_user}\","
+            "\"gists_url\":\"%s/gists{/gist_id}\",\"starred_url\":\"%s/starred{/owner}{/repo}\",\"subscriptions_url\":\"%s/subscriptions\","
+            "\"organizations_url\":\"%s/orgs\",\"repos_url\":\"%s/repos\",\"events_url\":\"%s/events{/privacy}\",\"received_events_url\":\"%s/received_events\","
+            "\"type\":\"User\",\"site_admin\":false}",
+            login.c_str(),(long long)id,(long long)id,(long long)id,u.c_str(),login.c_str(),u.c_str(),u.c_str(),u.c_str(),u.c_str(),u.c_str(),u.c_str(),u.c_str(),u.c_str(),u.c_str());
+    }
+    
+    //same fields and shapes as the objects returned by api.github.com/repos/coelckers/gzdoom/releases
+    static std::string release(int major,int minor,int patch,std::mt19937_64 &rng){
+        const std::string base="https://api.github.com/repos/coelckers/gzdoom/releases";
+        const int64_t id=20000000+major*10000+minor*100+patch;
+        const std::string tag=Util::str_printf("g%d.%d.%d",major,minor,patch);
+        const std::string date=Util::str_printf("20%02d-%02d-%02dT%02d:%02d:%02dZ",18+minor%6,1+patch%12,1+minor%28,int(rng()%24),int(rng()%60),int(rng()%60));
+        const std::string uploader=user("coelckers",1208453);
+        const char * asset_names[]={"gzdoom-%d-%d-%d-windows.zip","gzdoom-%d-%d-%d-windows-32bit.zip","gzdoom-%d-%d-%d-macOS.zip","gzdoom-%d-%d-%d-linux-x86_64.tar.xz","gzdoom-%d-%d-%d-src.tar.gz"};
+        std::string assets;
+        for(size_t a=0;a<Util::arr_len(asset_names);a++){
+            const std::string name=Util::str_printf(asset_names[a],major,minor,patch);
+            const int64_t asset_id=id*10+a;
+            if(a>0)assets+=',';
+            Util::str_printf_to(assets,
+                "{\"url\":\"%s/assets/%lld\",\"id\":%lld,\"node_id\":\"MDEyOlJlbGVhc2VBc3NldD%lld\",\"name\":\"%s\",\"label\":null,\"uploader\":%s,"
+                "\"content_type\":\"application/octet-stream\",\"state\":\"uploaded\",\"size\":%llu,\"download_count\":%llu,"
+                "\"created_at\":\"%s\",\"updated_at\":\"%s\",\"browser_download_url\":\"https://github.com/coelckers/gzdoom/releases/download/%s/%s\"}",
+                base.c_str(),(long long)asset_id,(long long)asset_id,(long long)asset_id,name.c_str(),uploader.c_str(),
+                (unsigned long long)(rng()%40000000+8000000),(unsigned long long)(rng()%200000),date.c_str(),date.c_str(),tag.c_str(),name.c_str());
+        }
+        std::string body="## Highlights\\r\\n";
+        for(int i=0;i<20;i++){
+            Util::str_printf_to(body,"- Fixed \\\"%s\\\" handling in ZScript when a `%s` is nested %d levels deep (#%d)\\r\\n",
+                                i%2?"SetStateLabel":"A_SpawnItemEx",i%3?"struct":"class",int(rng()%9+1),int(rng()%2000+100));
+        }
+        return Util::str_printf(
+            "{\"url\":\"%s/%lld\",\"assets_url\":\"%s/%lld/assets\",\"upload_url\":\"https://uploads.github.com/repos/coelckers/gzdoom/releases/%lld/assets{?name,label}\","
+            "\"html_url\":\"https://github.com/coelckers/gzdoom/releases/tag/%s\",\"id\":%lld,\"author\":%s,\"node_id\":\"MDc6UmVsZWFzZT%lld\","
+            "\"tag_name\":\"%s\",\"target_commitish\":\"master\",\"name\":\"GZDoom %d.%d.%d\",\"draft\":false,\"prerelease\":%s,"
+            "\"created_at\":\"%s\",\"published_at\":\"%s\",\"assets\":[%s],"
+            "\"tarball_url\":\"https://api.github.com/repos/coelckers/gzdoom/tarball/%s\",\"zipball_url\":\"https://api.github.com/repos/coelckers/gzdoom/zipball/%s\","
+            "\"body\":\"%s\",\"reactions\":{\"url\":\"%s/%lld/reactions\",\"total_count\":%d,\"+1\":%d,\"-1\":0,\"laugh\":0,\"hooray\":%d,\"confused\":0,\"heart\":%d,\"rocket\":0,\"eyes\":0}}",
+            base.c_str(),(long long)id,base.c_str(),(long long)id,(long long)id,tag.c_str(),(long long)id,uploader.c_str(),(long long)id,
+            tag.c_str(),major,minor,patch,patch==0?"true":"false",date.c_str(),date.c_str(),assets.c_str(),tag.c_str(),tag.c_str(),
+            body.c_str(),base.c_str(),(long long)id,60,30,20,10);
+    }
+    
+    static std::string releases_latest(){
+        std::mt19937_64 rng(1);
+        return release(4,11,3,rng);
+    }
+    
+    static std::string releases_page(){
+        std::mt19937_64 rng(2);
+        std::string s="[";
+        for(int i=0;i<100;i++){
+            if(i>0)s+=',';
+            s+=release(4,11-i/10,9-i%10,rng);
+        }
+        return s+"]";
+    }
+    
+    //nested just under the default depth limit, alternating arrays and objects
+    static std::string deep(){
+        std::string s;
+        for(int r=0;r<200;r++){
+            s+=r?",":"[";
+            for(size_t d=0;d<JSON::default_max_depth-2;d++)s+=d%2?"{\"k\":":"[1,";
+            s+="null";
+            for(size_t d=JSON::default_max_depth-2;d-->0;)s+=d%2?"}":"]";
+        }
+        return s+"]";
+    }
+    
+    //one huge object, and an array of small flat objects
+    static std::string wide(){
+        std::string s="{\"keys\":{";
+        for(int i=0;i<100000;i++){
+            Util::str_printf_to(s,"%s\"key_%08x\":%d",i?",":"",unsigned(i*2654435761u),i);
+        }
+        s+="},\"rows\":[";
+        for(int i=0;i<50000;i++){
+            Util::str_printf_to(s,"%s{\"a\":%d,\"b\":\"row %d\",\"c\":true,\"d\":null}",i?",":"",i,i);
+        }
+        return s+"]}";
+    }
+    
+    static std::string numbers(){
+        std::mt19937_64 rng(3);
+        std::uniform_real_distribution<double> small(-1000.0,1000.0);
+        std::string s="[";
+        for(int i=0;i<500000;i++){
+            if(i>0)s+=',';
+            switch(i%4){
+            case 0:
+                s+=std::to_string(int64_t(rng()));
+                break;
+            case 1:
+                s+=std::to_string(int(rng()%100000));
+                break;
+            case 2:
+                Util::str_printf_to(s,"%.17g",small(rng));
+                break;
+            default:
+                Util::str_printf_to(s,"%.6e",small(rng)*1e100);
+            }
+        }
+        return s+"]";
+    }
+    
+    //release notes in several scripts, raw UTF-8 and the same text as \u escapes, emoji as surrogate pairs
+    static std::string unicode(){
+        const char * lines[]={
+            "Исправлена ошибка в обработке ZScript при вложенных структурах",
+            "修复了嵌套结构中的 ZScript 处理错误，提高了渲染性能",
+            "Behebt Abstürze beim Laden großer Karten – über 10% schneller",
+            "ZScript の入れ子構造の処理を修正しました 🎉🚀",
+        };
+        std::string s="[";
+        for(int i=0;i<5000;i++){
+            std::string_view line=lines[i%4];
+            if(i>0)s+=',';
+            s+="{\"raw\":\"";
+            s+=line;
+            s+="\",\"escaped\":\"";
+            //decode the line and write every non-ascii code point as \u escapes
+            for(size_t j=0;j<line.size();){
+                unsigned char c=line[j];
+                if(c<0x80){
+                    s+=char(c);
+                    j++;
+                    continue;
+                }
+                size_t len=c>=0xF0?4:c>=0xE0?3:2;
+                uint32_t cp=c&(0x7F>>len);
+                for(size_t k=1;k<len;k++)cp=(cp<<6)|(line[j+k]&0x3F);
+                j+=len;
+                if(cp>=0x10000){
+                    cp-=0x10000;
+                    Util::str_printf_to(s,"\\u%04x\\u%04x",unsigned(0xD800+(cp>>10)),unsigned(0xDC00+(cp&0x3FF)));
+                }else{
+                    Util::str_printf_to(s,"\\u%04x",unsigned(cp));
+                }
+            }
+            s+="\"}";
+        }
+        return s+"]";
+    }
+    
+}
+
+//same as in main.cpp
+struct Asset {
+    std::string name;
+    std::string browser_download_url;
+    
+    static constexpr auto json_fields=std::make_tuple(
+        JSON::field("name",&Asset::name),
+        JSON::field("browser_download_url",&Asset::browser_download_url)
+    );
+};
+
+struct Release {
+    std::string tag_name;
+    std::vector<Asset> assets;
+    
+    static constexpr auto json_fields=std::make_tuple(
+        JSON::field("tag_name",&Release::tag_name),
+        JSON::field("assets",&Release::assets)
+    );
+};
+
+//integer members of every width and signedness, for the range checks
+struct Limits {
+    uint8_t u8=0;
+    int8_t i8=0;
+    int64_t i64=0;
+    uint64_t u64=0;
+    std::vector<int> list;
+    std::vector<Asset> assets;
+    
+    static constexpr auto json_fields=std::make_tuple(
+        JSON::field("u8",&Limits::u8),
+        JSON::field("i8",&Limits::i8),
+        JSON::field("i64",&Limits::i64),
+        JSON::field("u64",&Limits::u64),
+        JSON::field("list",&Limits::list),
+        JSON::field("assets",&Limits::assets)
+    );
+};
+
+//visits every value, so that traversal costs can be compared, returns something that depends on all of them so it isn't optimized out
+static size_t walk(const JSON::Element &e){
+    if(e.is_arr()){
+        size_t n=0;
+        for(const JSON::Element &v:e.get_arr())n+=walk(v);
+        return n+1;
+    }else if(e.is_obj()){
+        size_t n=0;
+        for(auto &[k,v]:e.get_obj())n+=k.size()+walk(v);
+        return n+1;
+    }else if(e.is_str()){
+        return e.get_str_view().size();
+    }else if(e.is_number()){
+        return size_t(e.get_number_int());
+    }
+    return 1;
+}
+
+struct result_t {
+    double mb_per_s;
+    double allocs;
+    double alloc_kb;
+    size_t peak_rss_kb;
+};
+
+//repeats 'op' for at least 'seconds' and at least 3 times
+static result_t run(size_t bytes,double seconds,const std::function<void()> &op){
+    op();//warm up
+    reset_peak_rss();
+    size_t count0=alloc_count.load();
+    size_t bytes0=alloc_bytes.load();
+    size_t iterations=0;
+    auto start=std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed;
+    do{
+        op();
+        iterations++;
+        elapsed=std::chrono::steady_clock::now()-start;
+    }while(iterations<3||elapsed.count()<seconds);
+    return {
+        double(bytes)*iterations/elapsed.count()/1e6,
+        double(alloc_count.load()-count0)/iterations,
+        double(alloc_bytes.load()-bytes0)/iterations/1024,
+        peak_rss_kb(),
+    };
+}
+
+//the allocations main.cpp's handling of releases/latest is allowed, every phase is run twice first so that reused buffers are already grown
+//returns false if any budget is exceeded, or a phase doesn't allocate less than parsing the whole release into a tree
+static bool check_budgets(){
+    const std::string data=Corpus::releases_latest();
+    const JSON::Query query({
+        "/tag_name",
+        "/assets/*/name",
+        "/assets/*/browser_download_url",
+    });
+    JSON::Document doc;
+    JSON::Tape tape;
+    const JSON::Element parsed=JSON::parse(data);
+    std::vector<std::byte> snapshot_data=JSON::Snapshot::write(parsed);
+    std::string_view snapshot_view(reinterpret_cast<const char *>(snapshot_data.data()),snapshot_data.size());
+    size_t found=0;
+    
+    //the query and bind budgets are worked out from the release's shape, what they keep is the tag name and two strings per asset
+    const JSON::Element &parsed_assets=parsed["assets"];
+    const size_t assets=parsed_assets.size();
+    auto too_long=[&](size_t inline_size){
+        size_t n=parsed["tag_name"].get_str_view().size()>inline_size;
+        for(const JSON::Element &a:parsed_assets.get_arr()){
+            n+=(a["name"].get_str_view().size()>inline_size)+(a["browser_download_url"].get_str_view().size()>inline_size);
+        }
+        return n;
+    };
+    //containers grow one element at a time, and reallocate every time their capacity doubles
+    auto growths=[](size_t n){
+        size_t allocs=0;
+        for(size_t capacity=0;capacity<n;capacity=capacity?capacity*2:1)allocs++;
+        return allocs;
+    };
+    //each container is a box holding its element vector, the root and every asset keep two members
+    const size_t query_containers=(1+growths(2))+(1+growths(assets))+assets*(1+growths(2));
+    const size_t query_strings=too_long(JSON::Element::short_size)+assets*(std::strlen("browser_download_url")>JSON::Key::inline_size);
+    //StreamParser's container stack and token buffer, which the release's body is unescaped into in one go, and Binder's stack
+    const size_t stream_buffers=3;
+    const size_t bind_strings=too_long(std::string().capacity());
+    
+    //finds the windows download the way updateGZDoom does, on anything with the same accessors
+    auto find_download=[&](const auto &root){
+        found=0;
+        if(root["tag_name"].get_str_view().empty())return;
+        const auto &assets=root["assets"];
+        for(size_t i=0;i<assets.size();i++){
+            std::string_view name=assets[i]["name"].get_str_view();
+            if(name.find("windows")!=std::string_view::npos&&name.find(".zip")!=std::string_view::npos&&!assets[i]["browser_download_url"].get_str_view().empty()){
+                found++;
+                break;
+            }
+        }
+    };
+    
+    struct budget_t {
+        const char * phase;
+        size_t max_allocs;
+        std::function<void()> op;
+    };
+    
+    std::vector<budget_t> budgets={
+        //everything is allocated from the document's arena, which keeps its first block
+        {"document_parse",0,[&]{ doc.parse(data); }},
+        {"document_access",0,[&]{ find_download(doc.get_root()); }},
+        //the parser's token buffer for escaped strings, and both container stacks
+        {"document_stream",3,[&]{
+            doc.clear();
+            JSON::ElementBuilder builder(doc.get_resource(),&query,&doc.get_strings());
+            JSON::StreamParser parser(builder);
+            parser.feed(data);
+            parser.finish();
+            doc.set_root(builder.take());
+        }},
+        //the result isn't in an arena, and every container is allocated separately from its elements
+        {"query",query_containers+query_strings,[&]{ query.parse(data); }},
+        //only the assets vector, and strings too long for std::string's inline buffer
+        {"bind",stream_buffers+growths(assets)+bind_strings,[&]{
+            Release release;
+            JSON::bind(data,release);
+        }},
+        //the queue of containers left to check when opening it
+        {"snapshot_access",2,[&]{ find_download(JSON::Snapshot(snapshot_view).root()); }},
+        //the tape keeps its nodes between parses
+        {"tape",0,[&]{
+            tape.parse(data);
+            find_download(tape.root());
+        }},
+    };
+    
+    bool ok=true;
+    std::printf("%-20s %10s %10s %10s %10s\n","phase","allocs","frees","bytes","budget");
+    //what main.cpp did before any of these, a whole tree from the default resource, every phase has to allocate less
+    const alloc_stats_t baseline=count_allocs([&]{ find_download(JSON::parse(data)); });
+    std::printf("%-20s %10zu %10zu %10zu %10s\n","parse (baseline)",baseline.allocs,baseline.frees,baseline.bytes,"-");
+    for(budget_t &b:budgets){
+        b.op();
+        b.op();
+        alloc_stats_t stats=count_allocs(b.op);
+        bool within=stats.allocs<=b.max_allocs;
+        bool below=stats.allocs<baseline.allocs;
+        ok=ok&&within&&below;
+        std::printf("%-20s %10zu %10zu %10zu %10zu%s%s\n",b.phase,stats.allocs,stats.frees,stats.bytes,b.max_allocs,within?"":"  EXCEEDED",below?"":"  NOT BELOW BASELINE");
+    }
+    if(found!=1){
+        std::printf("expected to find 1 windows download, found %zu\n",found);
+        ok=false;
+    }
+    return ok;
+}
+
+//const get_str() on every kind of string a parse produces, it has to give the same value get_str_view() does without converting the string, and control characters have to survive a write/parse round trip as valid json
+//returns false if any of them throws or differs, or written strings have raw control characters or escapes json doesn't have
+static bool check_strings(){
+    const std::string data="{\"name\":\"gzdoom-4-11-3-windows.zip\",\"short\":\"ab\",\"escaped\":\"line\\nbreak\"}";
+    bool ok=true;
+    auto expect=[&](const char * kind,const JSON::Element &root,const char * key,std::string_view value){
+        try{
+            const JSON::Element &e=root[key];
+            const char * before=e.get_str_view().data();
+            if(e.get_str()!=value||e.get_str_view()!=value){
+                std::printf("%s: const get_str() of %s gave %s\n",kind,key,Util::quote_str_double(e.get_str()).c_str());
+                ok=false;
+            }
+            if(e.get_str_view().data()!=before){
+                std::printf("%s: const get_str() of %s converted the string\n",kind,key);
+                ok=false;
+            }
+        }catch(std::exception &ex){
+            std::printf("%s: const get_str() of %s threw: %s\n",kind,key,ex.what());
+            ok=false;
+        }
+    };
+    const JSON::Element parsed=JSON::parse(data);
+    JSON::Document doc;
+    doc.parse(data);
+    const JSON::Element &interned=doc.get_root();
+    for(auto [kind,root]:{std::pair<const char *,const JSON::Element *>{"parse",&parsed},{"document",&interned}}){
+        expect(kind,*root,"name","gzdoom-4-11-3-windows.zip");
+        expect(kind,*root,"short","ab");
+        expect(kind,*root,"escaped","line\nbreak");
+    }
+    //every control character, written with the escapes json has, has to parse back to the same string
+    std::string controls;
+    for(int c=0;c<0x20;c++)controls+=char(c);
+    controls+="\\\"\x7f/";
+    const JSON::Element written(controls);
+    for(const std::string &json:{written.to_json_min(),written.to_json()}){
+        for(size_t i=0;i<json.size();i++){
+            if(static_cast<unsigned char>(json[i])<0x20&&json[i]!='\n'){
+                std::printf("write: raw control character %d in %s\n",json[i],Util::quote_str_double(json).c_str());
+                ok=false;
+                break;
+            }
+            if(json[i]=='\\'&&!std::strchr("\"\\/bfnrtu",json[++i])){
+                std::printf("write: escape that isn't json \\%c in %s\n",json[i],Util::quote_str_double(json).c_str());
+                ok=false;
+                break;
+            }
+        }
+        try{
+            const JSON::Element reparsed=JSON::parse(json);
+            if(reparsed.get_str_view()!=controls||JSON::parse(reparsed.to_json_min()).get_str_view()!=controls){
+                std::printf("write: %s parsed back as %s\n",json.c_str(),Util::quote_str_double(reparsed.get_str_view()).c_str());
+                ok=false;
+            }
+        }catch(std::exception &ex){
+            std::printf("write: %s failed to parse back: %s\n",Util::quote_str_double(json).c_str(),ex.what());
+            ok=false;
+        }
+    }
+    return ok;
+}
+
+//parsing gives the exact value of every edge case, and writing then parsing again gives back bit identical numbers, for those and the numbers corpus
+//returns false if any number differs
+static bool check_numbers(){
+    bool ok=true;
+    auto same=[](const JSON::Element &a,const JSON::Element &b){
+        if(a.is_int()&&b.is_int()) return a.get_int()==b.get_int();
+        if(a.is_double()&&b.is_double()) return memcmp(&a.get_double(),&b.get_double(),sizeof(double))==0;
+        return false;
+    };
+    auto reparse=[](const JSON::Element &e,bool pretty){
+        std::string out;
+        JSON::Writer(out,pretty,false).write(e);
+        return std::make_pair(JSON::parse(out),out);
+    };
+    
+    const JSON::Element inf=JSON::Double(std::numeric_limits<double>::infinity());
+    const std::pair<const char *,JSON::Element> cases[]={
+        {"-9223372036854775808",JSON::Int(std::numeric_limits<int64_t>::min())},
+        {"9223372036854775807",JSON::Int(std::numeric_limits<int64_t>::max())},
+        {"9223372036854775808",JSON::Double(9223372036854775808.0)},//one past int64_t, becomes a double instead of wrapping
+        {"9007199254740991",JSON::Int(9007199254740991)},
+        {"9007199254740993",JSON::Int(9007199254740993)},
+        {"9007199254740991.0",JSON::Double(9007199254740991.0)},
+        {"9007199254740993.0",JSON::Double(9007199254740992.0)},//halfway between two doubles, rounds to even
+        {"5e-324",JSON::Double(std::numeric_limits<double>::denorm_min())},
+        {"2.2250738585072011e-308",JSON::Double(2.2250738585072011e-308)},
+        {"1e400",inf},
+        {"-1e400",JSON::Double(-std::numeric_limits<double>::infinity())},
+        {"1e-400",JSON::Double(0.0)},
+        {"-0.0",JSON::Double(-0.0)},
+    };
+    for(auto &[text,expected]:cases){
+        const JSON::Element e=JSON::parse(text);
+        if(!same(e,expected)){
+            std::printf("number %s parsed as %s\n",text,e.to_json_min().c_str());
+            ok=false;
+            continue;
+        }
+        auto [back,out]=reparse(e,false);
+        //json can't represent infinity, it's written as null
+        const bool infinite=e.is_double()&&!std::isfinite(e.get_double());
+        if(infinite?out!="null":!same(e,back)){
+            std::printf("number %s was written as %s\n",text,out.c_str());
+            ok=false;
+        }
+    }
+    
+    const JSON::Element numbers=JSON::parse(Corpus::numbers());
+    for(bool pretty:{false,true}){
+        const JSON::Element back=reparse(numbers,pretty).first;
+        const JSON::array_t &a=numbers.get_arr();
+        const JSON::array_t &b=back.get_arr();
+        size_t wrong=0;
+        for(size_t i=0;i<a.size();i++){
+            if(i>=b.size()||!same(a[i],b[i])){
+                if(wrong==0) std::printf("numbers corpus, %s: value %zu %s came back as %s\n",pretty?"pretty":"minified",i,a[i].to_json_min().c_str(),i<b.size()?b[i].to_json_min().c_str():"nothing");
+                wrong++;
+            }
+        }
+        if(wrong>0||a.size()!=b.size()){
+            std::printf("numbers corpus, %s: %zu of %zu values differ after a round trip\n",pretty?"pretty":"minified",wrong,a.size());
+            ok=false;
+        }
+    }
+    return ok;
+}
+
+//anything Snapshot::write accepts has to open again, it refuses nesting the default parse limit would reject instead of writing a snapshot that can't be opened
+//returns false if a snapshot fails to open, or write accepts or rejects the wrong depth
+static bool check_snapshot_depth(){
+    bool ok=true;
+    for(size_t depth:{JSON::default_max_depth-1,JSON::default_max_depth,JSON::default_max_depth+1,size_t(600)}){
+        const std::string data=std::string(depth,'[')+std::string(depth,']');
+        const JSON::Element e=JSON::parse(data,std::pmr::get_default_resource(),1000);
+        bool parses=true;
+        try{
+            JSON::parse(data);
+        }catch(std::runtime_error &){
+            parses=false;
+        }
+        std::vector<std::byte> snapshot;
+        try{
+            snapshot=JSON::Snapshot::write(e);
+        }catch(JSON::JSON_Exception &ex){
+            if(parses){
+                std::printf("snapshot of %zu nested arrays wasn't written: %s\n",depth,ex.what());
+                ok=false;
+            }
+            continue;
+        }
+        if(!parses){
+            std::printf("snapshot of %zu nested arrays was written, deeper than the default limit\n",depth);
+            ok=false;
+        }
+        try{
+            JSON::Snapshot(std::string_view(reinterpret_cast<const char *>(snapshot.data()),snapshot.size())).root();
+        }catch(JSON::JSON_Exception &ex){
+            std::printf("snapshot of %zu nested arrays was written but can't be opened: %s\n",depth,ex.what());
+            ok=false;
+        }
+    }
+    return ok;
+}
+
+//trees nested as deep as their max_depth allows, alternating arrays and objects, have to be copied, written and destroyed without running out of call stack
+//returns false if writing either the tree or its copy doesn't give back the input
+static bool check_deep(){
+    bool ok=true;
+    for(size_t depth:{JSON::default_max_depth,size_t(1000000)}){
+        std::string data;
+        for(size_t d=0;d<depth;d++)data+=d%2?"{\"k\":":"[1,";
+        data+="null";
+        for(size_t d=depth;d-->0;)data+=d%2?"}":"]";
+        std::optional<JSON::Element> parsed=JSON::parse(data,std::pmr::get_default_resource(),depth);
+        std::optional<JSON::Element> copy=*parsed;
+        if(parsed->to_json_min()!=data||copy->to_json_min()!=data){
+            std::printf("%zu deep: writing the tree or its copy didn't give back the input\n",depth);
+            ok=false;
+        }
+        parsed.reset();
+        copy.reset();
+    }
+    return ok;
+}
+
+//numbers bound to integer members have to be whole and in range, anything else throws instead of being truncated or wrapped, and null array elements are skipped
+//returns false if a number is accepted or rejected wrongly, or a null adds an element
+static bool check_bind(){
+    bool ok=true;
+    const char * fits[]{
+        R"({"u8":255,"i8":-128,"i64":-9223372036854775808,"u64":9223372036854775808})",//the last one only fits as a double
+        R"({"u8":0,"i8":127,"i64":-9.223372036854775808e18,"u64":1.8446744073709550e19})",
+        R"({"u8":2.0,"i8":-0.0,"i64":1e18,"u64":0})",
+    };
+    const char * doesnt_fit[]{
+        R"({"u8":256})",
+        R"({"u8":-1})",
+        R"({"i8":-129})",
+        R"({"i8":1.5})",
+        R"({"i64":9223372036854775808})",
+        R"({"i64":1e999})",
+        R"({"i64":-1e999})",
+        R"({"i64":0.1})",
+        R"({"u64":-1})",
+        R"({"u64":-0.5})",
+        R"({"u64":18446744073709551616})",
+    };
+    for(const char * data:fits){
+        Limits l;
+        try{
+            JSON::bind(data,l);
+        }catch(std::exception &e){
+            std::printf("bind %s: %s\n",data,e.what());
+            ok=false;
+        }
+    }
+    for(const char * data:doesnt_fit){
+        Limits l;
+        try{
+            JSON::bind(data,l);
+            std::printf("bind %s: accepted\n",data);
+            ok=false;
+        }catch(JSON::JSON_Exception &e){
+        }
+    }
+    Limits l;
+    JSON::bind(R"({"list":[null,1,null,2,null],"assets":[null,{"name":"a"},null]})",l);
+    if(l.list!=std::vector<int>{1,2}||l.assets.size()!=1||l.assets[0].name!="a"){
+        std::printf("bind: null array elements gave %zu ints and %zu assets\n",l.list.size(),l.assets.size());
+        ok=false;
+    }
+    return ok;
+}
+
+//parse_parallel has to give the same result as parse() for elements nested right up to the depth limit, and the same error one level past it
+//returns false if either differs
+static bool check_parallel_depth(){
+    bool ok=true;
+    std::string filler;
+    for(int i=0;i<20000;i++)filler+="{\"a\":[1,2,3],\"b\":\"text\"},";
+    for(size_t depth:{JSON::default_max_depth,JSON::default_max_depth+1}){
+        //the top-level array counts as one level
+        const std::string data="["+filler+std::string(depth-1,'[')+std::string(depth-1,']')+","+filler+"1]";
+        std::string serial,parallel;
+        try{
+            serial=JSON::parse(data).to_json_min();
+        }catch(std::exception &e){
+            serial=e.what();
+        }
+        try{
+            parallel=JSON::parse_parallel(data,4).to_json_min();
+        }catch(std::exception &e){
+            parallel=e.what();
+        }
+        if(serial!=parallel){
+            std::printf("%zu deep: parse_parallel gave %s, parse(): %s\n",depth,parallel.substr(0,200).c_str(),serial.substr(0,200).c_str());
+            ok=false;
+        }
+    }
+    return ok;
+}
+
+//what Util::split_str used to search with before PatternFinder, every pattern is searched for separately
+static std::pair<size_t,size_t> first_of_vec(const std::string &str,size_t offset,const std::vector<std::string> &vec){
+    size_t start=std::string::npos;
+    size_t len=std::string::npos;
+    for(auto &elem:vec){
+        if(auto i=str.find(elem,offset);i!=std::string::npos){
+            if(start==std::string::npos||i<start){
+                start=i;
+                len=elem.size();
+            }
+        }
+    }
+    return {start,len};
+}
+
+//the lazy splitters have to give the same tokens as Util::split, and PatternFinder the same matches as searching for every pattern separately, for patterns that overlap
+//returns false if any token or match differs
+static bool check_split(){
+    bool ok=true;
+    auto compare=[&](const char * what,const std::string &in,bool split_empty,const std::vector<std::string_view> &got,const std::vector<std::string> &expected){
+        if(!std::equal(got.begin(),got.end(),expected.begin(),expected.end())){
+            std::printf("%s(%s,%s) gave %zu tokens, Util::split %zu\n",what,Util::quote_str_double(in).c_str(),split_empty?"true":"false",got.size(),expected.size());
+            ok=false;
+        }
+    };
+    for(const std::string in:{"","a",",",",,","a,",",a","a,,b,",",,a,,b,,","a;b,;c;;d;"}){
+        for(bool split_empty:{false,true}){
+            compare("split_any_view",in,split_empty,Util::split_any_view(in,",;",split_empty).to_vector(),Util::split(in,std::vector<char>{',',';'},split_empty));
+        }
+        //without split_empty Util::split keeps an empty token for a separator at the start, see split_view
+        compare("split_view",in,true,Util::split_view(in,',',true).to_vector(),Util::split(in,',',true));
+    }
+    const std::vector<std::string> pattern_sets[]{
+        {"ab","b","aba","bab","a","abab"},
+        {"aaa","aa","a"},
+        {"ba","abb","bb","babb"},
+        {"abba","bba","ba"},
+    };
+    std::mt19937_64 rng(20);
+    for(const std::vector<std::string> &patterns:pattern_sets){
+        const Util::PatternFinder finder(patterns);
+        for(int n=0;n<2000;n++){
+            std::string str(rng()%40,'a');
+            for(char &c:str)c="ab"[rng()%2];
+            for(size_t offset=0;offset<=str.size();offset++){
+                auto [start,len]=finder.find(str,offset);
+                auto [old_start,old_len]=first_of_vec(str,offset,patterns);
+                if(start!=old_start||(start!=std::string::npos&&len!=old_len)){
+                    std::printf("PatternFinder in %s from %zu found %zu+%zu, first_of_vec %zu+%zu\n",str.c_str(),offset,start,len,old_start,old_len);
+                    return false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+//writefile_binary has to write everything when write() takes less than it was given or is interrupted, and throw when nothing more can be written
+//returns false if what was written differs, or writing to a full device doesn't throw
+static bool check_writefile(){
+    bool ok=true;
+    //more than one write_chunk_size, so a regular file takes several writes too
+    std::vector<std::byte> data(9_M+3);
+    std::mt19937_64 rng(21);
+    for(std::byte &b:data)b=std::byte(rng());
+    const std::string path=temp_path("writefile");
+    try{
+        Util::writefile_binary(path,data);
+        const std::string back=Util::readfile(path);
+        if(back.size()!=data.size()||std::memcmp(back.data(),data.data(),data.size())!=0){
+            std::printf("writefile_binary: file read back differs\n");
+            ok=false;
+        }
+    }catch(std::exception &e){
+        std::printf("writefile_binary: %s\n",e.what());
+        ok=false;
+    }
+    std::remove(path.c_str());
+#ifndef _WIN32
+    //a pipe only takes what the reader has made room for, so a signal arriving during a write cuts it short, or fails it with EINTR if nothing was written yet
+    int p[2];
+    if(pipe(p)==0){
+        struct sigaction sa{},old;
+        sa.sa_handler=[](int){};//no SA_RESTART, so interrupted writes return
+        sigaction(SIGUSR1,&sa,&old);
+        std::vector<std::byte> got;
+        std::thread reader([&]{
+            std::byte buf[64_K];
+            ssize_t n;
+            while((n=read(p[0],buf,sizeof(buf)))>0)got.insert(got.end(),buf,buf+n);
+        });
+        std::atomic_bool done{false};
+        const pthread_t writer=pthread_self();
+        std::thread interrupter([&]{
+            while(!done){
+                pthread_kill(writer,SIGUSR1);
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+        try{
+            Util::writefile_binary("/proc/self/fd/"+std::to_string(p[1]),data);
+        }catch(std::exception &e){
+            std::printf("writefile_binary to a pipe: %s\n",e.what());
+            ok=false;
+        }
+        done=true;
+        interrupter.join();
+        close(p[1]);
+        reader.join();
+        close(p[0]);
+        sigaction(SIGUSR1,&old,nullptr);
+        if(got!=data){
+            std::printf("writefile_binary to a pipe: the %zu bytes read back don't match the %zu written\n",got.size(),data.size());
+            ok=false;
+        }
+    }
+    try{
+        Util::writefile_binary("/dev/full",data);
+        std::printf("writefile_binary to /dev/full didn't throw\n");
+        ok=false;
+    }catch(std::runtime_error &e){
+    }
+#endif
+    return ok;
+}
+
+//ChunkedBuffer has to read back what was appended from any offset, including reads that start, end or cross where one block ends and the next begins
+//returns false if a read gives the wrong bytes or count
+static bool check_chunked_buffer(){
+    const size_t chunk=Util::ChunkedBuffer::chunk_size;
+    std::mt19937_64 rng(24);
+    //without reserve it's all chunks, with it a first block that isn't chunk sized, then chunks once that's full
+    for(size_t reserved:{size_t(0),chunk/3,3*chunk+5}){
+        Util::ChunkedBuffer buf;
+        buf.reserve(reserved);
+        std::vector<std::byte> expected;
+        for(size_t len:{size_t(1),size_t(777),chunk-1,size_t(3),2*chunk+5,size_t(0),chunk}){
+            std::vector<std::byte> piece(len);
+            for(std::byte &b:piece)b=std::byte(rng());
+            buf.append(piece.data(),piece.size());
+            expected.insert(expected.end(),piece.begin(),piece.end());
+        }
+        if(buf.size()!=expected.size()){
+            std::printf("ChunkedBuffer reserving %zu: size %zu instead of %zu\n",reserved,buf.size(),expected.size());
+            return false;
+        }
+        std::vector<size_t> boundaries{0,reserved,expected.size()};
+        for(size_t b=reserved;b<expected.size();b+=chunk)boundaries.push_back(b);
+        std::vector<std::byte> out(2*chunk+16);
+        for(size_t boundary:boundaries){
+            for(size_t offset=boundary>2?boundary-2:0;offset<=boundary+2;offset++){
+                for(size_t len:{size_t(1),size_t(2),size_t(4),chunk,chunk+3,out.size()}){
+                    const size_t n=buf.read(offset,out.data(),len);
+                    const size_t in_range=offset<expected.size()?std::min(len,expected.size()-offset):0;
+                    if(n!=in_range||(n>0&&std::memcmp(out.data(),expected.data()+offset,n)!=0)){
+                        std::printf("ChunkedBuffer reserving %zu: reading %zu bytes at %zu gave %zu of the %zu expected, or different ones\n",reserved,len,offset,n,in_range);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//MappedOutputFile has to take up the size it was given while open, grow past it when needed, be cut down to what was written when closed,
+//refuse to open a file that already exists without touching it, and not leave a file behind when it can't be created
+//returns false if a file has the wrong size or contents, or opening an existing file doesn't throw
+static bool check_mapped_output(){
+    bool ok=true;
+    const std::string path=temp_path("mapped");
+    std::mt19937_64 rng(25);
+    //written size below, at, and past the preallocated one, and nothing at all
+    for(auto [size,written]:{std::pair<size_t,size_t>{64_K,1000},{64_K,64_K},{64_K,200_K+1},{0,0},{0,10}}){
+        std::string data(written,'\0');
+        for(char &c:data)c=char(rng());
+        try{
+            {
+                Util::MappedOutputFile f(path,size);
+                if(std::filesystem::file_size(path)<size){
+                    std::printf("MappedOutputFile of %zu: only %zu bytes while open\n",size,size_t(std::filesystem::file_size(path)));
+                    ok=false;
+                }
+                //in uneven pieces, so growing happens in the middle of one
+                for(size_t i=0;i<data.size();i+=777)f.append(data.data()+i,std::min<size_t>(777,data.size()-i));
+                if(f.data()!=data){
+                    std::printf("MappedOutputFile of %zu: data() differs after writing %zu bytes\n",size,written);
+                    ok=false;
+                }
+                try{
+                    Util::MappedOutputFile again(path,size);
+                    std::printf("MappedOutputFile of %zu: opened a file that was already open\n",size);
+                    ok=false;
+                }catch(std::runtime_error &e){
+                }
+            }
+            if(Util::readfile(path)!=data){
+                std::printf("MappedOutputFile of %zu: file isn't the %zu bytes written once closed\n",size,written);
+                ok=false;
+            }
+            //an existing file has to be left alone
+            try{
+                Util::MappedOutputFile f(path,size);
+                std::printf("MappedOutputFile of %zu: opened an existing file\n",size);
+                ok=false;
+            }catch(std::runtime_error &e){
+                if(Util::readfile(path)!=data){
+                    std::printf("MappedOutputFile of %zu: failing to open an existing file changed it\n",size);
+                    ok=false;
+                }
+            }
+        }catch(std::exception &e){
+            std::printf("MappedOutputFile of %zu: %s\n",size,e.what());
+            ok=false;
+        }
+        std::remove(path.c_str());
+    }
+    //too large for any file system, or to map
+    try{
+        Util::MappedOutputFile f(path,size_t(1)<<62);
+        std::printf("MappedOutputFile of 2^62 bytes didn't throw\n");
+        ok=false;
+    }catch(std::runtime_error &e){
+        if(std::filesystem::exists(path)){
+            std::printf("MappedOutputFile of 2^62 bytes left its file behind\n");
+            ok=false;
+        }
+    }
+    std::remove(path.c_str());
+    return ok;
+}
+
+//the thread pool's results, cancellation and error propagation, on a pool of its own so it has several workers even on one core
+//returns false if a result is wrong, cancelled work still runs to the end, or an exception is lost
+static bool check_thread_pool(){
+    bool ok=true;
+    Util::ThreadPool pool(4);
+    std::vector<std::future<size_t>> results;
+    for(size_t i=0;i<100;i++)results.push_back(pool.submit([i]{ return i*i; }));
+    for(size_t i=0;i<results.size();i++){
+        if(results[i].get()!=i*i){
+            std::printf("thread pool: task %zu gave the wrong result\n",i);
+            ok=false;
+            break;
+        }
+    }
+    try{
+        pool.submit([]()->int{ throw std::runtime_error("task failed"); }).get();
+        std::printf("thread pool: a task's exception was lost\n");
+        ok=false;
+    }catch(std::runtime_error &e){
+        if(std::strcmp(e.what(),"task failed")!=0){
+            std::printf("thread pool: a task threw %s\n",e.what());
+            ok=false;
+        }
+    }
+    Util::CancelToken cancelled;
+    cancelled.cancel();
+    try{
+        pool.submit([]{ return 1; },cancelled).get();
+        std::printf("thread pool: a cancelled task ran\n");
+        ok=false;
+    }catch(Util::Cancelled &){
+    }
+    //every run cancels, so only the runs that had started before the first one did can get through, at most one per thread
+    const size_t n=1000;
+    std::atomic<size_t> ran{0};
+    Util::CancelToken cancel;
+    try{
+        Util::parallel_for(n,[&](size_t begin,size_t end){
+            cancel.cancel();
+            ran+=end-begin;
+        },cancel,pool);
+        std::printf("parallel_for: didn't throw Cancelled\n");
+        ok=false;
+    }catch(Util::Cancelled &){
+        if(ran==0||ran>=n){
+            std::printf("parallel_for: %zu of %zu indices ran after cancelling\n",ran.load(),n);
+            ok=false;
+        }
+    }
+    try{
+        Util::parallel_for(n,[&](size_t begin,size_t end){
+            if(begin<=n/2&&n/2<end)throw std::runtime_error("index "+std::to_string(n/2));
+        },Util::CancelToken(),pool);
+        std::printf("parallel_for: an exception was lost\n");
+        ok=false;
+    }catch(std::runtime_error &e){
+        if(e.what()!="index "+std::to_string(n/2)){
+            std::printf("parallel_for: rethrew %s\n",e.what());
+            ok=false;
+        }
+    }
+    std::vector<size_t> in(10000);
+    for(size_t i=0;i<in.size();i++)in[i]=i;
+    const std::vector<size_t> squares=Util::parallel_map(in,[](size_t i){ return i*i; },Util::CancelToken(),pool);
+    Util::parallel_for_each(in,[](size_t &i){ i++; },Util::CancelToken(),pool);
+    for(size_t i=0;i<in.size();i++){
+        if(squares[i]!=i*i||in[i]!=i+1){
+            std::printf("parallel_map/parallel_for_each: index %zu gave %zu and %zu\n",i,squares[i],in[i]);
+            ok=false;
+            break;
+        }
+    }
+    return ok;
+}
+
+//StreamParser has to fail with the same message as parse() on bad input, whether it gets it whole or one byte at a time, and ignore what follows the top-level value the same way
+//returns false if any message differs
+static bool check_stream_errors(){
+    const char * inputs[]={
+        "{x","[true1","truex","1.2.3","[1.2.3]","[1e]","[1e+]","[nul]","nul","[-x]","[.]","+.5","[1-2]","[truefalse]","[1E5e]",
+        "{\"a\" 1}","{\"a\":1 x}","{\"a\":tru}","[1 /x]","[1 /","/","[/","[1 /* c */ x]","[\"\\u12\"]","[\"a","[1,","{","{\"a\"","{\"a\":",
+        "[1 2]","[[[","\"a\" x","[1,2] x",
+    };
+    auto error=[](const std::function<void()> &op) -> std::string {
+        try{
+            op();
+            return "no error";
+        }catch(std::exception &e){
+            return e.what();
+        }
+    };
+    bool ok=true;
+    for(const char * input:inputs){
+        const std::string_view data(input);
+        const std::string expected=error([&]{ JSON::parse(data); });
+        for(size_t chunk:{data.size(),size_t(1)}){
+            const std::string got=error([&]{
+                JSON::ElementBuilder builder;
+                JSON::StreamParser parser(builder);
+                for(size_t i=0;i<data.size();i+=chunk)parser.feed(data.substr(i,chunk));
+                parser.finish();
+            });
+            if(got!=expected){
+                std::printf("stream error for %s, fed %s: %s, parse(): %s\n",Util::quote_str_double(input).c_str(),chunk==1?"byte by byte":"whole",got.c_str(),expected.c_str());
+                ok=false;
+            }
+        }
+    }
+    return ok;
+}
+
+static const char * scan_names[]={"scalar","sse2","avx2"};
+
+int main(int argc,char ** argv) try {
+    double seconds=0.5;
+    std::vector<JSON::Internal::scan_impl_t> scan_impls{JSON::Internal::get_scan_impl()};
+    std::vector<std::pair<std::string,std::string>> corpus;
+    for(int i=1;i<argc;i++){
+        if(strcmp(argv[i],"-t")==0&&i+1<argc){
+            seconds=atof(argv[++i]);
+        }else if(strcmp(argv[i],"-scan")==0&&i+1<argc){
+            scan_impls.clear();
+            const char * requested=argv[++i];
+            for(int k=JSON::Internal::SCAN_SCALAR;k<=JSON::Internal::SCAN_AVX2;k++){
+                const JSON::Internal::scan_impl_t impl=JSON::Internal::scan_impl_t(k);
+                if(strcmp(requested,"all")!=0&&strcmp(requested,scan_names[impl])!=0) continue;
+                //set_scan_impl falls back to the best one the cpu has, which is what's reported
+                const JSON::Internal::scan_impl_t used=JSON::Internal::set_scan_impl(impl);
+                if(used!=impl){
+                    std::printf("%s isn't supported by this cpu, %s\n",scan_names[impl],strcmp(requested,"all")==0?"skipped":(std::string("using ")+scan_names[used]).c_str());
+                    if(strcmp(requested,"all")==0) continue;
+                }
+                scan_impls.push_back(used);
+            }
+            if(scan_impls.empty()) throw std::runtime_error(std::string("Unknown -scan ")+requested+", expected scalar, sse2, avx2 or all");
+        }else if(strcmp(argv[i],"-check")==0){
+            const bool budgets_ok=check_budgets();
+            const bool strings_ok=check_strings();
+            const bool numbers_ok=check_numbers();
+            const bool snapshot_ok=check_snapshot_depth();
+            const bool stream_ok=check_stream_errors();
+            const bool deep_ok=check_deep();
+            const bool parallel_ok=check_parallel_depth();
+            const bool bind_ok=check_bind();
+            const bool pool_ok=check_thread_pool();
+            const bool split_ok=check_split();
+            const bool writefile_ok=check_writefile();
+            const bool chunked_ok=check_chunked_buffer();
+            const bool mapped_ok=check_mapped_output();
+            return (budgets_ok&&strings_ok&&numbers_ok&&snapshot_ok&&stream_ok&&deep_ok&&parallel_ok&&bind_ok&&pool_ok&&split_ok&&writefile_ok&&chunked_ok&&mapped_ok)?0:1;
+        }else{
+            corpus.emplace_back(argv[i],Util::readfile(argv[i]));
+        }
+    }
+    corpus.emplace_back("releases_latest",Corpus::releases_latest());
+    corpus.emplace_back("releases_page",Corpus::releases_page());
+    corpus.emplace_back("deep",Corpus::deep());
+    corpus.emplace_back("wide",Corpus::wide());
+    corpus.emplace_back("numbers",Corpus::numbers());
+    corpus.emplace_back("unicode",Corpus::unicode());
+    
+    //what main.cpp extracts from releases/latest, and the same for every release of a releases page
+    const JSON::Query query({
+        "/tag_name",
+        "/assets/*/name",
+        "/assets/*/browser_download_url",
+    });
+    const JSON::Query query_page({
+        "/*/tag_name",
+        "/*/assets/*/name",
+        "/*/assets/*/browser_download_url",
+    });
+    
+    std::printf("%-20s %10s  %-14s %-7s %10s %12s %14s %12s\n","corpus","KB","op","scan","MB/s","allocs/op","KB alloc/op","peak RSS KB");
+    for(JSON::Internal::scan_impl_t impl:scan_impls){
+        JSON::Internal::set_scan_impl(impl);
+        for(auto &[name,data]:corpus){
+            JSON::Element parsed=JSON::parse(data);
+            std::string insitu;
+            std::string out;
+            std::vector<std::byte> snapshot=JSON::Snapshot::write(parsed);
+            JSON::Document doc;
+            JSON::Tape tape;
+            volatile size_t walked;
+            JSON::Digest digest;
+            
+            std::vector<std::pair<const char *,std::function<void()>>> ops={
+                {"parse",[&]{ JSON::parse(data); }},
+                {"parse_parallel",[&]{ JSON::parse_parallel(data); }},
+                //the copy of the input is part of what it costs to use parse_insitu
+                {"parse_insitu",[&]{ insitu=data; JSON::parse_insitu(insitu); }},
+                {"document",[&]{ doc.parse(data); }},
+                {"tape",[&]{ tape.parse(data); }},
+                //what it costs to get the same tree out of a tape instead of parsing it directly
+                {"tape_element",[&]{ tape.parse(data); tape.root().to_element(); }},
+                {"stream_64K",[&]{
+                    JSON::ElementBuilder builder;
+                    JSON::StreamParser parser(builder);
+                    for(size_t i=0;i<data.size();i+=64_K)parser.feed(std::string_view(data).substr(i,64_K));
+                    parser.finish();
+                    builder.take();
+                }},
+                {"query",[&]{ (parsed.is_arr()?query_page:query).parse(data); }},
+                //only for inputs shaped like releases, others fail on the first mismatched type
+                {"bind",[&]{
+                    if(parsed.is_arr()){
+                        std::vector<Release> releases;
+                        JSON::bind(data,releases);
+                    }else{
+                        Release release;
+                        JSON::bind(data,release);
+                    }
+                }},
+                {"walk",[&]{ walked=walk(parsed); }},
+                {"digest",[&]{ digest.compute(parsed); }},
+                {"to_json_min",[&]{ out.clear(); JSON::Writer(out,false,false).write(parsed); }},
+                {"to_json",[&]{ out.clear(); JSON::Writer(out).write(parsed); }},
+                {"snapshot_write",[&]{ snapshot=JSON::Snapshot::write(parsed); }},
+                //checking the snapshot is all opening it does, MB/s is of the json it came from
+                {"snapshot_open",[&]{ JSON::Snapshot(std::string_view(reinterpret_cast<const char *>(snapshot.data()),snapshot.size())).root(); }},
+            };
+            
+            for(auto &[op_name,op]:ops){
+                if(strcmp(op_name,"bind")==0){
+                    try{
+                        op();
+                    }catch(JSON::JSON_Exception &){
+                        continue;
+                    }
+                }
+                result_t r=run(data.size(),seconds,op);
+                std::printf("%-20s %10zu  %-14s %-7s %10.1f %12.1f %14.1f %12zu\n",name.c_str(),data.size()/1024,op_name,scan_names[impl],r.mb_per_s,r.allocs,r.alloc_kb,r.peak_rss_kb);
+                std::fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}catch(std::exception &e){
+    std::fprintf(stderr,"%s\n",e.what());
+    return 1;
+}
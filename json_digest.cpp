@@ -0,0 +1,212 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#include "json.h"
+#include <cstring>
+
+namespace JSON {
+    
+    namespace {
+        
+        //every type starts from its own seed, so values of different types that happen to have the same contents don't collide
+        enum seed_t : uint64_t {
+            SEED_INT=0x243f6a8885a308d3,
+            SEED_DOUBLE=0x13198a2e03707344,
+            SEED_STRING=0xa4093822299f31d0,
+            SEED_LITERAL=0x082efa98ec4e6c89,
+            SEED_ARRAY=0x452821e638d01377,
+            SEED_OBJECT=0xbe5466cf34e90c6c,
+        };
+        
+        //splitmix64's finalizer, every input bit affects every output bit
+        constexpr uint64_t mix(uint64_t h){
+            h^=h>>30;
+            h*=0xbf58476d1ce4e5b9;
+            h^=h>>27;
+            h*=0x94d049bb133111eb;
+            h^=h>>31;
+            return h;
+        }
+        
+        //order dependent, so [1,2] and [2,1] hash differently
+        constexpr uint64_t combine(uint64_t h,uint64_t v){
+            return mix(h^(v+0x9e3779b97f4a7c15+(h<<6)+(h>>2)));
+        }
+        
+        //8 bytes at a time, words are read in native byte order, so hashes only match between machines of the same endianness
+        uint64_t hash_bytes(uint64_t seed,std::string_view s){
+            uint64_t h=combine(seed,s.size());
+            size_t i=0;
+            for(;i+8<=s.size();i+=8){
+                uint64_t w;
+                memcpy(&w,s.data()+i,8);
+                h=combine(h,w);
+            }
+            if(i<s.size()){
+                uint64_t w=0;
+                memcpy(&w,s.data()+i,s.size()-i);
+                h=combine(h,w);
+            }
+            return h;
+        }
+        
+        uint64_t hash_scalar(const Element &e){
+            if(e.is_int()){
+                return combine(SEED_INT,uint64_t(e.get_int()));
+            }else if(e.is_double()){
+                uint64_t bits;
+                double d=e.get_double();
+                memcpy(&bits,&d,sizeof(bits));
+                return combine(SEED_DOUBLE,bits);
+            }else if(e.is_str()){
+                return hash_bytes(SEED_STRING,e.get_str_view());
+            }else{
+                return combine(SEED_LITERAL,e.is_null()?2:e.get_bool());
+            }
+        }
+        
+        //appends a JSON Pointer reference token, escaping '~' and '/'
+        void push_token(std::string &path,std::string_view key){
+            path+='/';
+            for(char c:key){
+                if(c=='~'){
+                    path+="~0";
+                }else if(c=='/'){
+                    path+="~1";
+                }else{
+                    path+=c;
+                }
+            }
+        }
+        
+    }
+    
+    uint64_t hash(const Element &e){
+        if(e.is_arr()){
+            uint64_t h=SEED_ARRAY;
+            for(const Element &v:e.get_arr()){
+                h=combine(h,hash(v));
+            }
+            return combine(h,e.size());
+        }else if(e.is_obj()){
+            uint64_t h=SEED_OBJECT;
+            for(auto &[k,v]:e.get_obj()){
+                h=combine(combine(h,hash_bytes(SEED_STRING,k)),hash(v));
+            }
+            return combine(h,e.size());
+        }
+        return hash_scalar(e);
+    }
+    
+    Digest::Digest(const Element &e){
+        compute(e);
+    }
+    
+    void Digest::compute(const Element &e){
+        nodes.clear();
+        add(e);
+    }
+    
+    //same as hash(), but keeps every subtree's hash along the way
+    uint64_t Digest::add(const Element &e){
+        const size_t index=nodes.size();
+        nodes.push_back({0,0});
+        uint64_t h;
+        if(e.is_arr()){
+            h=SEED_ARRAY;
+            for(const Element &v:e.get_arr()){
+                h=combine(h,add(v));
+            }
+            h=combine(h,e.size());
+        }else if(e.is_obj()){
+            h=SEED_OBJECT;
+            for(auto &[k,v]:e.get_obj()){
+                h=combine(combine(h,hash_bytes(SEED_STRING,k)),add(v));
+            }
+            h=combine(h,e.size());
+        }else{
+            h=hash_scalar(e);
+        }
+        nodes[index]={h,nodes.size()};
+        return h;
+    }
+    
+    namespace {
+        
+        using changed_t=std::function<void(const std::string &path,const Element * before,const Element * after)>;
+        
+        //'ia' and 'ib' are the nodes of 'a' and 'b' in their digests, 'path' is theirs, and is restored before returning
+        template<typename Nodes>
+        void diff_node(const Element &a,const Nodes &na,size_t ia,const Element &b,const Nodes &nb,size_t ib,std::string &path,const changed_t &changed){
+            if(na[ia].hash==nb[ib].hash) return;
+            const size_t len=path.size();
+            if(a.is_arr()&&b.is_arr()){
+                const array_t &x=a.get_arr();
+                const array_t &y=b.get_arr();
+                size_t ca=ia+1;
+                size_t cb=ib+1;
+                for(size_t k=0;k<x.size()||k<y.size();k++){
+                    path+='/';
+                    path+=std::to_string(k);
+                    if(k<x.size()&&k<y.size()){
+                        diff_node(x[k],na,ca,y[k],nb,cb,path,changed);
+                    }else{
+                        changed(path,k<x.size()?&x[k]:nullptr,k<y.size()?&y[k]:nullptr);
+                    }
+                    path.resize(len);
+                    if(k<x.size())ca=na[ca].next;
+                    if(k<y.size())cb=nb[cb].next;
+                }
+            }else if(a.is_obj()&&b.is_obj()){
+                //both are sorted by key, so they can be merged in one pass
+                const object_t &x=a.get_obj();
+                const object_t &y=b.get_obj();
+                auto ita=x.begin();
+                auto itb=y.begin();
+                size_t ca=ia+1;
+                size_t cb=ib+1;
+                while(ita!=x.end()||itb!=y.end()){
+                    const bool in_a=ita!=x.end()&&(itb==y.end()||std::string_view(ita->first)<=std::string_view(itb->first));
+                    const bool in_b=itb!=y.end()&&(ita==x.end()||std::string_view(itb->first)<=std::string_view(ita->first));
+                    push_token(path,in_a?ita->first:itb->first);
+                    if(in_a&&in_b){
+                        diff_node(ita->second,na,ca,itb->second,nb,cb,path,changed);
+                    }else{
+                        changed(path,in_a?&ita->second:nullptr,in_b?&itb->second:nullptr);
+                    }
+                    path.resize(len);
+                    if(in_a){
+                        ca=na[ca].next;
+                        ++ita;
+                    }
+                    if(in_b){
+                        cb=nb[cb].next;
+                        ++itb;
+                    }
+                }
+            }else{
+                changed(path,&a,&b);
+            }
+        }
+        
+    }
+    
+    void diff(const Element &a,const Digest &da,const Element &b,const Digest &db,const changed_t &changed){
+        if(da.nodes.empty()||db.nodes.empty()) throw std::logic_error("JSON::diff, digest wasn't computed");
+        std::string path;
+        diff_node(a,da.nodes,0,b,db.nodes,0,path,changed);
+    }
+    
+}
@@ -0,0 +1,153 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#pragma once
+
+//lexing helpers shared between the JSON parsers, not part of the public interface
+
+#include "json.h"
+
+namespace JSON {
+    namespace Internal {
+        
+        constexpr bool is_whitespace(char c){
+            return c==' '||c=='\t'||c=='\r'||c=='\n';
+        }
+        
+        constexpr bool is_word_start(char c){
+            return (c>='a'&&c<='z')||(c>='A'&&c<='Z')||c=='_';
+        }
+        
+        constexpr bool is_number(char c){
+            return (c>='0'&&c<='9');
+        }
+        
+        constexpr bool is_word_char(char c){
+            return (c>='a'&&c<='z')||(c>='A'&&c<='Z')||(c>='0'&&c<='9')||c=='_';
+        }
+        
+        constexpr char unescape(char c){
+            switch(c) {
+            case 'a':
+                return '\a';
+            case 'b':
+                return '\b';
+            case 'e':
+                return '\e';
+            case 'f':
+                return '\f';
+            case 'n':
+                return '\n';
+            case 'r':
+                return '\r';
+            case 't':
+                return '\t';
+            case 'v':
+                return '\v';
+            case '\\':
+                return '\\';
+            case '"':
+                return '\"';
+            default:
+                return c;
+            }
+        }
+        
+        std::string escape_char_str(char c);
+        
+        //syntax errors, shared so that every parser words them the same way, 'expected' is either a description like "JSON" or a character quoted by quote_char
+        [[noreturn]] void unexpected_char(const std::string &expected,char c,size_t pos);
+        [[noreturn]] void unexpected_eof(const std::string &expected);
+        
+        inline std::string quote_char(char c){
+            return "'"+escape_char_str(c)+"'";
+        }
+        
+        inline bool is_char(std::string_view data, size_t &i,char c){
+            return (i<data.size())&&(data[i]==c);
+        }
+        
+        inline void expect_char(std::string_view data, size_t &i,char c){
+            if(i>=data.size()) unexpected_eof(quote_char(c));
+            if(data[i]!=c) unexpected_char(quote_char(c),data[i],i);
+        }
+        
+        enum scan_impl_t {
+            SCAN_SCALAR,
+            SCAN_SSE2,
+            SCAN_AVX2,
+        };
+        
+        //the best implementation the cpu supports is picked at startup, set_scan_impl can only lower it, and returns the one actually used
+        scan_impl_t get_scan_impl();
+        scan_impl_t set_scan_impl(scan_impl_t impl);
+        
+        //block scanning, these return the position of the first matching character at or after 'i', or data.size() if there's none
+        size_t scan_string(std::string_view data,size_t i);//'"', '\\' or '\n'
+        size_t scan_non_whitespace(std::string_view data,size_t i);
+        size_t scan_structural(std::string_view data,size_t i);//'"', '[', ']', '{', '}', or comment starts
+        size_t scan_utf8(std::string_view data,size_t i);//first byte that isn't part of a valid UTF-8 sequence
+        size_t scan_char(std::string_view data,size_t i,char c);
+        
+        bool is_number_start_nosign(std::string_view data, size_t i);
+        bool is_number_start(std::string_view data, size_t i);
+        
+        //a number literal split up by scan_number, without converting it to a value yet
+        struct number_parts_t {
+            size_t start;//position of the sign, if any
+            size_t number_start;//position after the sign
+            uint64_t mantissa=0;
+            int digits=0;//significant digits in mantissa, leading zeros aren't counted
+            int64_t exponent=0;//power of ten mantissa has to be multiplied by
+            bool truncated=false;//there were more digits than fit in mantissa
+            bool is_double=false;//has a fraction or exponent
+            bool is_negative;
+            
+            bool is_int() const {
+                return !is_double&&!truncated&&mantissa<=uint64_t(INT64_MAX)+is_negative;
+            }
+        };
+        
+        //checks the syntax of a number and moves 'i' past it, throws the same errors as get_number
+        //'pos' is added to the positions in error messages, for when 'data' is only part of the input
+        number_parts_t scan_number(std::string_view data, size_t &i,size_t pos=0);
+        
+        //handles integers, decimals and scientific notation, integers that don't fit in an int64_t are returned as doubles
+        Element get_number(std::string_view data, size_t &i,size_t pos=0);
+        
+        constexpr size_t max_double_chars=32;
+        
+        //writes the shortest representation that parses back to the same double, returns the length
+        size_t format_double(double d,char * buf);
+        
+        //scans a string literal, returns its contents without the quotes, 'escaped' is set if they contain escapes or newlines that need to be removed
+        std::string_view get_string_raw(std::string_view data, size_t &i,bool &escaped);
+        
+        //throws if the contents of a string literal aren't valid UTF-8, or have a \u escape without 4 hex digits, 'pos' is where they start in the input
+        void check_string(std::string_view raw,size_t pos,bool escaped);
+        
+        //unescaped strings are never longer than the raw ones, so 'out' may point to the start of 'raw' itself
+        //\u escapes are decoded into UTF-8, including surrogate pairs, unpaired surrogates become U+FFFD, 'raw' must have passed check_string
+        size_t unescape_str(std::string_view raw,char * out);
+        
+        void skip_whitespace(std::string_view data, size_t &i); //SAFE TO CALL ON EOF, skips comments
+        
+        bool get_literal(std::string_view data, size_t &i,JSON_Literal &l);
+        
+        //skips over an element without decoding it, containers are only checked for unterminated strings and brackets
+        void skip_element(std::string_view data, size_t &i);
+        
+    }
+}
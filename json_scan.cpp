@@ -0,0 +1,398 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#include "json_internal.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__)||defined(__i386__)
+    #define JSON_SCAN_X86
+    #include <immintrin.h>
+#endif
+
+namespace JSON {
+    namespace Internal {
+        
+        namespace {
+            
+            constexpr bool is_string_special(char c){
+                return c=='"'||c=='\\'||c=='\n';
+            }
+            
+            constexpr bool is_structural(char c){
+                return c=='"'||c=='['||c==']'||c=='{'||c=='}'||c=='#'||c=='/';
+            }
+            
+            size_t scan_string_scalar(const char * p,size_t i,size_t n){
+                while(i<n&&!is_string_special(p[i]))i++;
+                return i;
+            }
+            
+            size_t scan_non_whitespace_scalar(const char * p,size_t i,size_t n){
+                while(i<n&&is_whitespace(p[i]))i++;
+                return i;
+            }
+            
+            size_t scan_structural_scalar(const char * p,size_t i,size_t n){
+                while(i<n&&!is_structural(p[i]))i++;
+                return i;
+            }
+            
+            //length of the valid UTF-8 sequence starting with a non-ASCII byte at 'i', 0 if it's invalid
+            //rejects overlong encodings, surrogates and anything above U+10FFFF
+            size_t utf8_sequence(const char * p,size_t i,size_t n){
+                const unsigned char * u=reinterpret_cast<const unsigned char *>(p);
+                const unsigned char c=u[i];
+                size_t len;
+                unsigned char lo=0x80;//range of the second byte
+                unsigned char hi=0xBF;
+                if(c>=0xC2&&c<=0xDF){
+                    len=2;
+                }else if(c>=0xE0&&c<=0xEF){
+                    len=3;
+                    if(c==0xE0)lo=0xA0;
+                    if(c==0xED)hi=0x9F;
+                }else if(c>=0xF0&&c<=0xF4){
+                    len=4;
+                    if(c==0xF0)lo=0x90;
+                    if(c==0xF4)hi=0x8F;
+                }else{
+                    return 0;
+                }
+                if(n-i<len||u[i+1]<lo||u[i+1]>hi) return 0;
+                for(size_t j=2;j<len;j++){
+                    if((u[i+j]&0xC0)!=0x80) return 0;
+                }
+                return len;
+            }
+            
+            bool is_ascii_scalar(const char * p,size_t i,size_t n){
+                uint64_t bits=0;
+                for(;i+8<=n;i+=8){
+                    uint64_t v;
+                    memcpy(&v,p+i,8);
+                    bits|=v;
+                }
+                for(;i<n;i++)bits|=static_cast<unsigned char>(p[i]);
+                return !(bits&0x8080808080808080);
+            }
+            
+            size_t scan_utf8_scalar(const char * p,size_t i,size_t n){
+                while(i<n){
+                    if(i+8<=n){
+                        uint64_t v;
+                        memcpy(&v,p+i,8);
+                        if(!(v&0x8080808080808080)){
+                            i+=8;
+                            continue;
+                        }
+                    }
+                    if(static_cast<unsigned char>(p[i])<0x80){
+                        i++;
+                    }else if(size_t len=utf8_sequence(p,i,n)){
+                        i+=len;
+                    }else{
+                        return i;
+                    }
+                }
+                return n;
+            }
+            
+            #ifdef JSON_SCAN_X86
+            
+            //each block is turned into a bitmask of the interesting characters, the first set bit is the result
+            
+            __attribute__((target("sse2"))) inline unsigned mask_string_sse2(__m128i v){
+                __m128i m=_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('"')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\\'))),_mm_cmpeq_epi8(v,_mm_set1_epi8('\n')));
+                return _mm_movemask_epi8(m);
+            }
+            
+            __attribute__((target("sse2"))) inline unsigned mask_whitespace_sse2(__m128i v){
+                __m128i m=_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(' ')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\t'))),_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('\r')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\n'))));
+                return _mm_movemask_epi8(m);
+            }
+            
+            __attribute__((target("sse2"))) inline unsigned mask_structural_sse2(__m128i v){
+                __m128i m=_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('"')),_mm_cmpeq_epi8(v,_mm_set1_epi8('#')));
+                m=_mm_or_si128(m,_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('/')),_mm_cmpeq_epi8(v,_mm_set1_epi8('['))));
+                m=_mm_or_si128(m,_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(']')),_mm_cmpeq_epi8(v,_mm_set1_epi8('{'))));
+                m=_mm_or_si128(m,_mm_cmpeq_epi8(v,_mm_set1_epi8('}')));
+                return _mm_movemask_epi8(m);
+            }
+            
+            __attribute__((target("sse2"))) size_t scan_string_sse2(const char * p,size_t i,size_t n){
+                for(;i+16<=n;i+=16){
+                    if(unsigned m=mask_string_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p+i)))) return i+__builtin_ctz(m);
+                }
+                return scan_string_scalar(p,i,n);
+            }
+            
+            __attribute__((target("sse2"))) size_t scan_non_whitespace_sse2(const char * p,size_t i,size_t n){
+                for(;i+16<=n;i+=16){
+                    if(unsigned m=~mask_whitespace_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p+i)))&0xFFFF) return i+__builtin_ctz(m);
+                }
+                return scan_non_whitespace_scalar(p,i,n);
+            }
+            
+            __attribute__((target("sse2"))) size_t scan_structural_sse2(const char * p,size_t i,size_t n){
+                for(;i+16<=n;i+=16){
+                    if(unsigned m=mask_structural_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p+i)))) return i+__builtin_ctz(m);
+                }
+                return scan_structural_scalar(p,i,n);
+            }
+            
+            //sse2 has no byte shuffles for the lookup tables the avx2 version uses, so it only skips over ascii blocks
+            __attribute__((target("sse2"))) size_t scan_utf8_sse2(const char * p,size_t i,size_t n){
+                while(i+16<=n){
+                    if(unsigned m=_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p+i)))){
+                        i+=__builtin_ctz(m);
+                        do{
+                            size_t len=utf8_sequence(p,i,n);
+                            if(!len) return i;
+                            i+=len;
+                        }while(i<n&&static_cast<unsigned char>(p[i])>=0x80);
+                    }else{
+                        i+=16;
+                    }
+                }
+                return scan_utf8_scalar(p,i,n);
+            }
+            
+            __attribute__((target("avx2"))) inline unsigned mask_string_avx2(__m256i v){
+                __m256i m=_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8('"')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\\'))),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\n')));
+                return _mm256_movemask_epi8(m);
+            }
+            
+            __attribute__((target("avx2"))) inline unsigned mask_whitespace_avx2(__m256i v){
+                __m256i m=_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8(' ')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\t'))),_mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\r')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\n'))));
+                return _mm256_movemask_epi8(m);
+            }
+            
+            __attribute__((target("avx2"))) inline unsigned mask_structural_avx2(__m256i v){
+                __m256i m=_mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8('"')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('#')));
+                m=_mm256_or_si256(m,_mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8('/')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('['))));
+                m=_mm256_or_si256(m,_mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8(']')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('{'))));
+                m=_mm256_or_si256(m,_mm256_cmpeq_epi8(v,_mm256_set1_epi8('}')));
+                return _mm256_movemask_epi8(m);
+            }
+            
+            __attribute__((target("avx2"))) size_t scan_string_avx2(const char * p,size_t i,size_t n){
+                for(;i+32<=n;i+=32){
+                    if(unsigned m=mask_string_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i)))) return i+__builtin_ctz(m);
+                }
+                return scan_string_sse2(p,i,n);
+            }
+            
+            __attribute__((target("avx2"))) size_t scan_non_whitespace_avx2(const char * p,size_t i,size_t n){
+                for(;i+32<=n;i+=32){
+                    if(unsigned m=~mask_whitespace_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i)))) return i+__builtin_ctz(m);
+                }
+                return scan_non_whitespace_sse2(p,i,n);
+            }
+            
+            __attribute__((target("avx2"))) size_t scan_structural_avx2(const char * p,size_t i,size_t n){
+                for(;i+32<=n;i+=32){
+                    if(unsigned m=mask_structural_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i)))) return i+__builtin_ctz(m);
+                }
+                return scan_structural_sse2(p,i,n);
+            }
+            
+            //utf-8 validation with lookup tables, as described in "Validating UTF-8 In Less Than One Instruction Per Byte" (Keiser, Lemire)
+            //every pair of consecutive bytes is classified by the high nibble of the first byte, its low nibble, and the high nibble of the second byte,
+            //the three lookups are anded together, and any bit left set is a specific kind of error
+            namespace UTF8 {
+                constexpr uint8_t TOO_SHORT=1<<0;//lead byte not followed by a continuation
+                constexpr uint8_t TOO_LONG=1<<1;//ascii followed by a continuation
+                constexpr uint8_t OVERLONG_3=1<<2;
+                constexpr uint8_t TOO_LARGE=1<<3;//above U+10FFFF
+                constexpr uint8_t SURROGATE=1<<4;
+                constexpr uint8_t OVERLONG_2=1<<5;
+                constexpr uint8_t TOO_LARGE_1000=1<<6;
+                constexpr uint8_t OVERLONG_4=1<<6;
+                constexpr uint8_t TWO_CONTS=1<<7;//two continuations, only valid as the 3rd/4th byte of a sequence, checked separately
+                constexpr uint8_t CARRY=TOO_SHORT|TOO_LONG|TWO_CONTS;
+            }
+            
+            __attribute__((target("avx2"))) inline __m256i table_avx2(uint8_t t0,uint8_t t1,uint8_t t2,uint8_t t3,uint8_t t4,uint8_t t5,uint8_t t6,uint8_t t7,uint8_t t8,uint8_t t9,uint8_t t10,uint8_t t11,uint8_t t12,uint8_t t13,uint8_t t14,uint8_t t15){
+                return _mm256_setr_epi8(t0,t1,t2,t3,t4,t5,t6,t7,t8,t9,t10,t11,t12,t13,t14,t15,t0,t1,t2,t3,t4,t5,t6,t7,t8,t9,t10,t11,t12,t13,t14,t15);
+            }
+            
+            //the block shifted right by 'N' bytes, with the last bytes of the previous block shifted in
+            template<int N>
+            __attribute__((target("avx2"))) inline __m256i prev_avx2(__m256i v,__m256i prev){
+                return _mm256_alignr_epi8(v,_mm256_permute2x128_si256(prev,v,0x21),16-N);
+            }
+            
+            //error bits for every byte of 'v', 'prev' is the previous block
+            __attribute__((target("avx2"))) inline __m256i utf8_errors_avx2(__m256i v,__m256i prev){
+                using namespace UTF8;
+                const __m256i nibble=_mm256_set1_epi8(0x0F);
+                __m256i prev1=prev_avx2<1>(v,prev);
+                __m256i byte_1_high=_mm256_shuffle_epi8(table_avx2(
+                    //0_______ ________, ascii
+                    TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,
+                    //10______ ________, continuation
+                    TWO_CONTS,TWO_CONTS,TWO_CONTS,TWO_CONTS,
+                    //1100____ ________, 2 byte lead
+                    TOO_SHORT|OVERLONG_2,
+                    //1101____ ________, 2 byte lead
+                    TOO_SHORT,
+                    //1110____ ________, 3 byte lead
+                    TOO_SHORT|OVERLONG_3|SURROGATE,
+                    //1111____ ________, 4 byte lead
+                    TOO_SHORT|TOO_LARGE|TOO_LARGE_1000|OVERLONG_4
+                ),_mm256_and_si256(_mm256_srli_epi16(prev1,4),nibble));
+                __m256i byte_1_low=_mm256_shuffle_epi8(table_avx2(
+                    //____0000 ________
+                    CARRY|OVERLONG_3|OVERLONG_2|OVERLONG_4,
+                    //____0001 ________
+                    CARRY|OVERLONG_2,
+                    //____001_ ________
+                    CARRY,
+                    CARRY,
+                    //____0100 ________
+                    CARRY|TOO_LARGE,
+                    //____0101 ________ and up
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    //____1101 ________
+                    CARRY|TOO_LARGE|TOO_LARGE_1000|SURROGATE,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000,
+                    CARRY|TOO_LARGE|TOO_LARGE_1000
+                ),_mm256_and_si256(prev1,nibble));
+                __m256i byte_2_high=_mm256_shuffle_epi8(table_avx2(
+                    //________ 0_______, ascii
+                    TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,
+                    //________ 1000____
+                    TOO_LONG|OVERLONG_2|TWO_CONTS|OVERLONG_3|TOO_LARGE_1000|OVERLONG_4,
+                    //________ 1001____
+                    TOO_LONG|OVERLONG_2|TWO_CONTS|OVERLONG_3|TOO_LARGE,
+                    //________ 101_____
+                    TOO_LONG|OVERLONG_2|TWO_CONTS|SURROGATE|TOO_LARGE,
+                    TOO_LONG|OVERLONG_2|TWO_CONTS|SURROGATE|TOO_LARGE,
+                    //________ 11______, lead
+                    TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT
+                ),_mm256_and_si256(_mm256_srli_epi16(v,4),nibble));
+                __m256i special=_mm256_and_si256(_mm256_and_si256(byte_1_high,byte_1_low),byte_2_high);
+                //two continuations in a row are fine if they're the 3rd or 4th byte of a sequence, which is known from the lead two or three bytes back
+                __m256i third=_mm256_subs_epu8(prev_avx2<2>(v,prev),_mm256_set1_epi8(char(0xE0-0x80)));
+                __m256i fourth=_mm256_subs_epu8(prev_avx2<3>(v,prev),_mm256_set1_epi8(char(0xF0-0x80)));
+                __m256i must_continue=_mm256_and_si256(_mm256_or_si256(third,fourth),_mm256_set1_epi8(char(0x80)));
+                return _mm256_xor_si256(must_continue,special);
+            }
+            
+            __attribute__((target("avx2"))) size_t scan_utf8_avx2(const char * p,size_t i,size_t n){
+                const size_t start=i;
+                //blocks ending in the middle of a sequence, where the next block can't be skipped even if it's ascii
+                const __m256i incomplete_max=_mm256_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,char(0xF0-1),char(0xE0-1),char(0xC0-1));
+                __m256i prev=_mm256_setzero_si256();
+                __m256i incomplete=_mm256_setzero_si256();
+                __m256i errors=_mm256_setzero_si256();
+                for(;i+32<=n;i+=32){
+                    __m256i v=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i));
+                    if(!_mm256_movemask_epi8(v)){
+                        errors=_mm256_or_si256(errors,incomplete);
+                        incomplete=_mm256_setzero_si256();
+                    }else{
+                        errors=_mm256_or_si256(errors,utf8_errors_avx2(v,prev));
+                        incomplete=_mm256_subs_epu8(v,incomplete_max);
+                    }
+                    prev=v;
+                }
+                //most strings are short and ascii, and end up here right away
+                if(!_mm256_testz_si256(incomplete,incomplete)||!is_ascii_scalar(p,i,n)){
+                    //the tail is padded with ascii, so a sequence cut off by the end shows up as too short
+                    char tail[32]={};
+                    memcpy(tail,p+i,n-i);
+                    errors=_mm256_or_si256(errors,utf8_errors_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail)),prev));
+                }
+                if(_mm256_testz_si256(errors,errors)) return n;
+                //only says whether there's an error, find where with the scalar version
+                return scan_utf8_scalar(p,start,n);
+            }
+            
+            #endif
+            
+            struct scan_functions {
+                size_t (*string)(const char *,size_t,size_t);
+                size_t (*non_whitespace)(const char *,size_t,size_t);
+                size_t (*structural)(const char *,size_t,size_t);
+                size_t (*utf8)(const char *,size_t,size_t);
+            };
+            
+            constexpr scan_functions scan_impls[] {
+                {scan_string_scalar,scan_non_whitespace_scalar,scan_structural_scalar,scan_utf8_scalar},
+                #ifdef JSON_SCAN_X86
+                {scan_string_sse2,scan_non_whitespace_sse2,scan_structural_sse2,scan_utf8_sse2},
+                {scan_string_avx2,scan_non_whitespace_avx2,scan_structural_avx2,scan_utf8_avx2},
+                #endif
+            };
+            
+            scan_impl_t best_scan_impl(){
+                #ifdef JSON_SCAN_X86
+                    __builtin_cpu_init();
+                    if(__builtin_cpu_supports("avx2")) return SCAN_AVX2;
+                    if(__builtin_cpu_supports("sse2")) return SCAN_SSE2;
+                #endif
+                return SCAN_SCALAR;
+            }
+            
+            scan_impl_t current_impl=best_scan_impl();
+            const scan_functions * scan=&scan_impls[current_impl];
+        }
+        
+        scan_impl_t get_scan_impl(){
+            return current_impl;
+        }
+        
+        scan_impl_t set_scan_impl(scan_impl_t impl){
+            current_impl=std::min(impl,best_scan_impl());
+            scan=&scan_impls[current_impl];
+            return current_impl;
+        }
+        
+        size_t scan_string(std::string_view data,size_t i){
+            return scan->string(data.data(),i,data.size());
+        }
+        
+        size_t scan_non_whitespace(std::string_view data,size_t i){
+            //most whitespace runs are a single space or newline, don't bother with blocks for those
+            if(i<data.size()&&!is_whitespace(data[i])) return i;
+            if(i+1<data.size()&&!is_whitespace(data[i+1])) return i+1;
+            return scan->non_whitespace(data.data(),i,data.size());
+        }
+        
+        size_t scan_structural(std::string_view data,size_t i){
+            return scan->structural(data.data(),i,data.size());
+        }
+        
+        size_t scan_utf8(std::string_view data,size_t i){
+            return scan->utf8(data.data(),i,data.size());
+        }
+        
+        size_t scan_char(std::string_view data,size_t i,char c){
+            if(i>=data.size()) return data.size();
+            const void * p=memchr(data.data()+i,c,data.size()-i);
+            return p?static_cast<const char*>(p)-data.data():data.size();
+        }
+        
+    }
+}
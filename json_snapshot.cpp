@@ -0,0 +1,372 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#include "json.h"
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <tuple>
+
+namespace JSON {
+    
+    namespace {
+        
+        //file layout:
+        //  0: magic "JSONSNAP"
+        //  8: u32 version
+        // 12: u32 reserved, 0
+        // 16: u64 size of the whole snapshot
+        // 24: root node
+        //node layout:
+        //  0: u8 type
+        //  4: u32 length of a string, or number of elements/members of a container
+        //  8: i64/double value, or u64 offset of the string's bytes/the container's nodes
+        //containers are written breadth first, so the node blocks of containers always come after their own node, in the order the containers appear
+        
+        constexpr char magic[8]={'J','S','O','N','S','N','A','P'};
+        constexpr uint32_t version=1;
+        constexpr size_t header_size=24;
+        constexpr size_t node_size=16;
+        
+        enum node_type : unsigned {
+            NODE_NULL,
+            NODE_FALSE,
+            NODE_TRUE,
+            NODE_INT,
+            NODE_DOUBLE,
+            NODE_STRING,
+            NODE_ARRAY,
+            NODE_OBJECT,
+        };
+        
+        template<typename T>
+        T load(const char * p){
+            T v;
+            memcpy(&v,p,sizeof(T));
+#if defined(__BYTE_ORDER__)&&__BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+            std::reverse(reinterpret_cast<char*>(&v),reinterpret_cast<char*>(&v)+sizeof(T));
+#endif
+            return v;
+        }
+        
+        template<typename T>
+        void store(std::vector<std::byte> &out,size_t offset,T v){
+#if defined(__BYTE_ORDER__)&&__BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+            std::reverse(reinterpret_cast<char*>(&v),reinterpret_cast<char*>(&v)+sizeof(T));
+#endif
+            memcpy(out.data()+offset,&v,sizeof(T));
+        }
+        
+        inline uint32_t node_length(const char * node){
+            return load<uint32_t>(node+4);
+        }
+        
+        inline uint64_t node_offset(const char * node){
+            return load<uint64_t>(node+8);
+        }
+        
+        //appends zeroed space, returns its offset, node blocks are aligned to 8 bytes, strings aren't aligned
+        size_t reserve(std::vector<std::byte> &out,size_t n,size_t align){
+            size_t offset=(out.size()+align-1)&~(align-1);
+            out.resize(offset+n);
+            return offset;
+        }
+        
+        //'depth' matches the one validate checks, so anything written here can be opened again
+        void write_node(std::vector<std::byte> &out,size_t offset,const Element &e,size_t depth,std::deque<std::tuple<size_t,const Element*,size_t>> &containers){
+            auto set_length=[&](size_t n){
+                if(n>UINT32_MAX) throw JSON_Exception("Value too big for a snapshot");
+                store<uint32_t>(out,offset+4,uint32_t(n));
+            };
+            unsigned type;
+            if(e.is_int()){
+                type=NODE_INT;
+                store<int64_t>(out,offset+8,e.get_int());
+            }else if(e.is_double()){
+                type=NODE_DOUBLE;
+                store<double>(out,offset+8,e.get_double());
+            }else if(e.is_str()){
+                type=NODE_STRING;
+                std::string_view s=e.get_str_view();
+                set_length(s.size());
+                size_t data=reserve(out,s.size()+1,1);
+                memcpy(out.data()+data,s.data(),s.size());
+                store<uint64_t>(out,offset+8,data);
+            }else if(e.is_arr()||e.is_obj()){
+                if(depth>=default_max_depth) throw JSON_Exception("Value nested too deep for a snapshot");
+                type=e.is_arr()?NODE_ARRAY:NODE_OBJECT;
+                containers.emplace_back(offset,&e,depth+1);
+            }else{
+                type=e.is_null()?NODE_NULL:e.get_bool()?NODE_TRUE:NODE_FALSE;
+            }
+            out[offset]=std::byte(type);
+        }
+        
+        void write_key(std::vector<std::byte> &out,size_t offset,std::string_view key){
+            if(key.size()>UINT32_MAX) throw JSON_Exception("Value too big for a snapshot");
+            out[offset]=std::byte(NODE_STRING);
+            store<uint32_t>(out,offset+4,uint32_t(key.size()));
+            size_t data=reserve(out,key.size()+1,1);
+            memcpy(out.data()+data,key.data(),key.size());
+            store<uint64_t>(out,offset+8,data);
+        }
+        
+        [[noreturn]] void invalid(const char * why){
+            throw JSON_Exception(std::string("Invalid snapshot, ")+why);
+        }
+        
+    }
+    
+    std::vector<std::byte> Snapshot::write(const Element &e){
+        std::vector<std::byte> out(header_size+node_size);
+        memcpy(out.data(),magic,sizeof(magic));
+        store<uint32_t>(out,8,version);
+        std::deque<std::tuple<size_t,const Element*,size_t>> containers;//node offset, container, depth of its children
+        write_node(out,header_size,e,0,containers);
+        while(!containers.empty()){
+            auto [offset,c,depth]=containers.front();
+            containers.pop_front();
+            if(c->is_arr()){
+                const array_t &arr=c->get_arr();
+                if(arr.size()>UINT32_MAX) throw JSON_Exception("Value too big for a snapshot");
+                size_t block=reserve(out,arr.size()*node_size,8);
+                for(size_t i=0;i<arr.size();i++){
+                    write_node(out,block+i*node_size,arr[i],depth,containers);
+                }
+                store<uint32_t>(out,offset+4,uint32_t(arr.size()));
+                store<uint64_t>(out,offset+8,block);
+            }else{
+                const object_t &obj=c->get_obj();
+                if(obj.size()>UINT32_MAX) throw JSON_Exception("Value too big for a snapshot");
+                size_t block=reserve(out,obj.size()*node_size*2,8);
+                size_t i=0;
+                for(auto &kv:obj){
+                    write_key(out,block+i*node_size,kv.first);
+                    write_node(out,block+(i+1)*node_size,kv.second,depth,containers);
+                    i+=2;
+                }
+                store<uint32_t>(out,offset+4,uint32_t(obj.size()));
+                store<uint64_t>(out,offset+8,block);
+            }
+        }
+        store<uint64_t>(out,16,out.size());
+        return out;
+    }
+    
+    Snapshot::Snapshot(const std::string &filename){
+        file.emplace(filename);
+        data=file->data();
+        validate();
+    }
+    
+    Snapshot::Snapshot(std::string_view d) : data(d) {
+        validate();
+    }
+    
+    //checks every node once, in the same breadth first order they were written in
+    //node blocks must come after the end of the previous one, which rules out cycles and shared blocks, so this is linear in the size of the snapshot
+    void Snapshot::validate(){
+        if(data.size()<header_size+node_size||memcmp(data.data(),magic,sizeof(magic))!=0) invalid("bad header");
+        if(load<uint32_t>(data.data()+8)!=version) invalid("unsupported version");
+        if(load<uint64_t>(data.data()+16)!=data.size()) invalid("truncated");
+        
+        const char * base=data.data();
+        size_t end=header_size+node_size;//end of the last container's nodes
+        
+        //checks a single node, containers are queued to have their nodes checked later
+        std::deque<std::pair<size_t,size_t>> containers;//node offset, depth
+        auto check=[&](size_t offset,size_t depth){
+            const char * node=base+offset;
+            unsigned type=load<uint8_t>(node);
+            if(type==NODE_STRING){
+                uint64_t str=node_offset(node);
+                if(str>data.size()||node_length(node)>=data.size()-str||base[str+node_length(node)]!='\0') invalid("string out of bounds");
+            }else if(type==NODE_ARRAY||type==NODE_OBJECT){
+                if(depth>=default_max_depth) invalid("nested too deep");
+                containers.emplace_back(offset,depth+1);
+            }else if(type>NODE_OBJECT){
+                invalid("unknown value type");
+            }
+        };
+        
+        check(header_size,0);
+        while(!containers.empty()){
+            auto [offset,depth]=containers.front();
+            containers.pop_front();
+            const char * node=base+offset;
+            const bool is_obj=load<uint8_t>(node)==NODE_OBJECT;
+            uint64_t block=node_offset(node);
+            uint64_t count=uint64_t(node_length(node))*(is_obj?2:1);
+            if(block<end||block%8!=0||block>data.size()||count>(data.size()-block)/node_size) invalid("container out of bounds");
+            end=block+count*node_size;
+            for(uint64_t i=0;i<count;i++){
+                check(block+i*node_size,depth);
+            }
+            if(is_obj){//keys have to be sorted for lookups to work
+                std::string_view prev;
+                for(uint64_t i=0;i<count;i+=2){
+                    const char * key=base+block+i*node_size;
+                    if(load<uint8_t>(key)!=NODE_STRING) invalid("object key isn't a string");
+                    std::string_view k(base+node_offset(key),node_length(key));
+                    if(i>0&&!(prev<k)) invalid("object keys out of order");
+                    prev=k;
+                }
+            }
+        }
+    }
+    
+    SnapshotValue Snapshot::root() const {
+        return SnapshotValue(data.data(),data.data()+header_size);
+    }
+    
+    unsigned SnapshotValue::type() const {
+        return load<uint8_t>(node);
+    }
+    
+    bool SnapshotValue::is_int() const { return type()==NODE_INT; }
+    bool SnapshotValue::is_double() const { return type()==NODE_DOUBLE; }
+    bool SnapshotValue::is_number() const { return type()==NODE_INT||type()==NODE_DOUBLE; }
+    bool SnapshotValue::is_str() const { return type()==NODE_STRING; }
+    bool SnapshotValue::is_arr() const { return type()==NODE_ARRAY; }
+    bool SnapshotValue::is_obj() const { return type()==NODE_OBJECT; }
+    bool SnapshotValue::is_bool() const { return type()==NODE_TRUE||type()==NODE_FALSE; }
+    bool SnapshotValue::is_null() const { return type()==NODE_NULL; }
+    
+    const char * SnapshotValue::type_name() const {
+        switch(type()){
+        case NODE_INT:
+            return "Integer";
+        case NODE_DOUBLE:
+            return "Double";
+        case NODE_STRING:
+            return "String";
+        case NODE_ARRAY:
+            return "Array";
+        case NODE_OBJECT:
+            return "Object";
+        case NODE_NULL:
+            return "Null";
+        case NODE_TRUE:
+        case NODE_FALSE:
+            return "Boolean";
+        default:
+            return "Unknown";
+        }
+    }
+    
+    int64_t SnapshotValue::get_int() const {
+        return is_int()?load<int64_t>(node+8):throw JSON_Exception("Integer",type_name());
+    }
+    
+    double SnapshotValue::get_double() const {
+        return is_double()?load<double>(node+8):throw JSON_Exception("Double",type_name());
+    }
+    
+    int64_t SnapshotValue::get_number_int() const {
+        return is_double()?static_cast<int64_t>(load<double>(node+8)):is_int()?load<int64_t>(node+8):throw JSON_Exception("Number",type_name());
+    }
+    
+    double SnapshotValue::get_number_double() const {
+        return is_double()?load<double>(node+8):is_int()?static_cast<double>(load<int64_t>(node+8)):throw JSON_Exception("Number",type_name());
+    }
+    
+    std::string_view SnapshotValue::get_str_view() const {
+        return is_str()?std::string_view(base+node_offset(node),node_length(node)):throw JSON_Exception("String",type_name());
+    }
+    
+    bool SnapshotValue::get_bool() const {
+        return is_bool()?type()==NODE_TRUE:throw JSON_Exception("Boolean",type_name());
+    }
+    
+    size_t SnapshotValue::size() const {
+        return (is_arr()||is_obj())?node_length(node):throw JSON_Exception(std::vector<std::string>{"Array","Object"},type_name());
+    }
+    
+    SnapshotValue SnapshotValue::operator[](size_t index) const {
+        if(!is_arr()) throw JSON_Exception("Array",type_name());
+        if(index>=node_length(node)) throw std::out_of_range("SnapshotValue::operator[]");
+        return SnapshotValue(base,base+node_offset(node)+index*node_size);
+    }
+    
+    SnapshotValue SnapshotValue::operator[](std::string_view key) const {
+        std::optional<SnapshotValue> v=find(key);
+        return v?*v:throw std::out_of_range("SnapshotValue::operator[]");
+    }
+    
+    std::string_view SnapshotValue::key(size_t index) const {
+        if(!is_obj()) throw JSON_Exception("Object",type_name());
+        if(index>=node_length(node)) throw std::out_of_range("SnapshotValue::key");
+        const char * k=base+node_offset(node)+index*2*node_size;
+        return std::string_view(base+node_offset(k),node_length(k));
+    }
+    
+    SnapshotValue SnapshotValue::value(size_t index) const {
+        if(!is_obj()) throw JSON_Exception("Object",type_name());
+        if(index>=node_length(node)) throw std::out_of_range("SnapshotValue::value");
+        return SnapshotValue(base,base+node_offset(node)+(index*2+1)*node_size);
+    }
+    
+    std::optional<SnapshotValue> SnapshotValue::find(std::string_view k) const {
+        if(!is_obj()) throw JSON_Exception("Object",type_name());
+        size_t lo=0;
+        size_t hi=node_length(node);
+        while(lo<hi){
+            size_t mid=lo+(hi-lo)/2;
+            std::string_view mid_key=key(mid);
+            if(mid_key==k) return value(mid);
+            if(mid_key<k){
+                lo=mid+1;
+            }else{
+                hi=mid;
+            }
+        }
+        return std::nullopt;
+    }
+    
+    //snapshots are at most default_max_depth deep, so this can't recurse too far
+    Element SnapshotValue::to_element(std::pmr::memory_resource * res) const {
+        switch(type()){
+        case NODE_INT:
+            return get_int();
+        case NODE_DOUBLE:
+            return get_double();
+        case NODE_STRING:
+            return String(get_str_view(),res);
+        case NODE_ARRAY:{
+                array_t arr(res);
+                arr.reserve(size());
+                for(size_t i=0;i<size();i++){
+                    arr.emplace_back((*this)[i].to_element(res));
+                }
+                return JSON::Array(std::move(arr));
+            }
+        case NODE_OBJECT:{
+                object_t obj(res);
+                obj.reserve(size());
+                for(size_t i=0;i<size();i++){
+                    obj.emplace_unsorted(key(i),value(i).to_element(res));
+                }
+                return JSON::Object(std::move(obj));//already sorted
+            }
+        case NODE_TRUE:
+            return JSON_TRUE;
+        case NODE_FALSE:
+            return JSON_FALSE;
+        default:
+            return JSON_NULL;
+        }
+    }
+    
+}
@@ -0,0 +1,525 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#include "json.h"
+#include "json_internal.h"
+#include <stdexcept>
+#include <cmath>
+
+namespace JSON {
+    
+    using namespace Internal;
+    
+    StreamParser::StreamParser(Handler &h,size_t d) : handler(h),max_depth(d) {
+        stack.reserve(initial_depth);
+        reset();
+    }
+    
+    void StreamParser::reset(){
+        stack.clear();
+        token.clear();
+        pos=0;
+        token_pos=0;
+        state=STATE_VALUE;
+        lex=LEX_NONE;
+        token_is_key=false;
+        token_escaped=false;
+        escape=false;
+        star=false;
+    }
+    
+    //throws the error parse() gives for 'c' at this point, 'at' is its position in the whole input
+    void StreamParser::unexpected(char c,size_t at){
+        switch(state){
+        case STATE_OBJECT_KEY:
+            unexpected_char(quote_char('"'),c,at);
+        case STATE_OBJECT_COLON:
+            unexpected_char(quote_char(':'),c,at);
+        case STATE_ARRAY_NEXT:
+        case STATE_OBJECT_NEXT:
+            unexpected_char(quote_char(','),c,at);
+        default:
+            unexpected_char("JSON",c,at);
+        }
+    }
+    
+    void StreamParser::end_value(){
+        if(stack.empty()){
+            state=STATE_DONE;
+        }else{
+            state=stack.back()=='['?STATE_ARRAY_NEXT:STATE_OBJECT_NEXT;
+        }
+    }
+    
+    void StreamParser::end_container(char c){
+        stack.pop_back();
+        if(c=='['){
+            handler.end_array();
+        }else{
+            handler.end_object();
+        }
+        end_value();
+    }
+    
+    void StreamParser::end_string(std::string_view s){
+        if(token_is_key){
+            handler.key(s);
+            state=STATE_OBJECT_COLON;
+        }else{
+            handler.value(s);
+            end_value();
+        }
+    }
+    
+    //parse() takes the longest number or literal at the start of the token, and treats whatever follows it as the next token, so the same is done here
+    //'next' is the character that ended the token, or null at the end of the input, it's never part of the value, but errors can be about it
+    void StreamParser::end_word(const char * next){
+        const size_t len=token.size();
+        if(next)token+=*next;
+        size_t i=0;
+        JSON_Literal l;
+        if(lex==LEX_NUMBER&&is_number_start(token,0)){
+            Element e=get_number(token,i,token_pos);
+            if(e.is_int()){
+                handler.value(e.get_int());
+            }else{
+                handler.value(e.get_double());
+            }
+        }else if(lex==LEX_LITERAL&&get_literal(token,i,l)){
+            handler.value(l);
+        }else{
+            unexpected_char("JSON",token[0],token_pos);
+        }
+        end_value();
+        //nothing that can follow a value can be part of a word, anything after the top-level value is ignored
+        if(i<len&&state!=STATE_DONE) unexpected(token[i],token_pos+i);
+        token.clear();
+        lex=LEX_NONE;
+    }
+    
+    //the raw contents are buffered, and checked and unescaped once the closing quote is found, the same way parse() does it
+    size_t StreamParser::feed_string(std::string_view data,size_t i){
+        const size_t n=data.size();
+        while(i<n){
+            if(escape){
+                token+=data[i++];
+                escape=false;
+                continue;
+            }
+            size_t start=i;
+            i=scan_string(data,i);
+            token.append(data.data()+start,i-start);
+            if(i==n)break;
+            char c=data[i++];
+            if(c=='"'){
+                lex=LEX_NONE;
+                check_string(token,token_pos,token_escaped);
+                if(token_escaped)token.resize(unescape_str(token,token.data()));
+                end_string(token);
+                token.clear();
+                break;
+            }
+            token+=c;//'\\' or a newline
+            token_escaped=true;
+            escape=c=='\\';
+        }
+        return i;
+    }
+    
+    size_t StreamParser::feed_token(std::string_view data,size_t i){
+        const char c=data[i];
+        switch(state){
+        case STATE_ARRAY_VALUE:
+            if(c==']'){
+                end_container('[');
+                return i+1;
+            }
+            [[fallthrough]];
+        case STATE_VALUE:
+            if(c=='['||c=='{'){
+                if(stack.size()>=max_depth) throw std::runtime_error("Maximum nesting depth of "+std::to_string(max_depth)+" exceeded at pos "+std::to_string(pos+i));
+                stack.push_back(c);
+                if(c=='['){
+                    handler.begin_array();
+                    state=STATE_ARRAY_VALUE;
+                }else{
+                    handler.begin_object();
+                    state=STATE_OBJECT_KEY;
+                }
+                return i+1;
+            }else if(c=='"'){
+                token_is_key=false;
+                break;
+            }else if(is_number(c)||c=='-'||c=='+'||c=='.'){
+                lex=LEX_NUMBER;
+                token_pos=pos+i;
+                return i;
+            }else if(is_word_start(c)){
+                lex=LEX_LITERAL;
+                token_pos=pos+i;
+                return i;
+            }
+            unexpected(c,pos+i);
+        case STATE_OBJECT_KEY:
+            if(c=='}'){
+                end_container('{');
+                return i+1;
+            }else if(c=='"'){
+                token_is_key=true;
+                break;
+            }
+            unexpected(c,pos+i);
+        case STATE_OBJECT_COLON:
+            if(c!=':') unexpected(c,pos+i);
+            state=STATE_VALUE;
+            return i+1;
+        case STATE_ARRAY_NEXT:
+            if(c==']'){
+                end_container('[');
+            }else if(c==','){
+                state=STATE_ARRAY_VALUE;
+            }else{
+                unexpected(c,pos+i);
+            }
+            return i+1;
+        case STATE_OBJECT_NEXT:
+            if(c=='}'){
+                end_container('{');
+            }else if(c==','){
+                state=STATE_OBJECT_KEY;
+            }else{
+                unexpected(c,pos+i);
+            }
+            return i+1;
+        case STATE_DONE:
+            return data.size();
+        }
+        //start of a string, strings that end inside this chunk are handled in one go, and passed through without copying if they need no unescaping
+        const size_t n=data.size();
+        size_t start=++i;
+        bool escaped=false;
+        for(;(i=scan_string(data,i))<n&&data[i]!='"';i++){
+            escaped=true;
+            if(data[i]=='\\')i++;
+        }
+        if(i<n){
+            std::string_view raw=data.substr(start,i-start);
+            check_string(raw,pos+start,escaped);
+            if(escaped){
+                token.resize(raw.size());
+                token.resize(unescape_str(raw,token.data()));
+                end_string(token);
+                token.clear();
+            }else{
+                end_string(raw);
+            }
+            return i+1;
+        }
+        //the rest is fed to feed_string as it arrives
+        i=scan_string(data,start);
+        token.assign(data.data()+start,i-start);
+        token_pos=pos+start;
+        token_escaped=false;
+        lex=LEX_STRING;
+        return i;
+    }
+    
+    void StreamParser::feed(std::string_view data){
+        const size_t n=data.size();
+        size_t i=0;
+        while(i<n&&state!=STATE_DONE){
+            switch(lex){
+            case LEX_NONE:
+                if(is_whitespace(data[i])){
+                    i=scan_non_whitespace(data,i);
+                }else if(data[i]=='#'){
+                    lex=LEX_LINE_COMMENT;
+                    i++;
+                }else if(data[i]=='/'){
+                    lex=LEX_COMMENT_START;
+                    token_pos=pos+i;
+                    i++;
+                }else{
+                    i=feed_token(data,i);
+                }
+                break;
+            case LEX_STRING:
+                i=feed_string(data,i);
+                break;
+            case LEX_NUMBER:
+            case LEX_LITERAL:{
+                    size_t start=i;
+                    if(lex==LEX_NUMBER){
+                        while(i<n&&(is_number(data[i])||data[i]=='.'||data[i]=='-'||data[i]=='+'||data[i]=='e'||data[i]=='E'))i++;
+                    }else{
+                        while(i<n&&is_word_char(data[i]))i++;
+                    }
+                    token.append(data.data()+start,i-start);
+                    if(i<n)end_word(&data[i]);
+                }
+                break;
+            case LEX_COMMENT_START:
+                if(data[i]=='/'){
+                    lex=LEX_LINE_COMMENT;
+                }else if(data[i]=='*'){
+                    lex=LEX_BLOCK_COMMENT;
+                    star=false;
+                }else{
+                    unexpected('/',token_pos);//not a comment after all, parse() fails on the '/' itself
+                }
+                i++;
+                break;
+            case LEX_LINE_COMMENT:
+                i=scan_char(data,i,'\n');
+                if(i<n){
+                    lex=LEX_NONE;
+                    i++;
+                }
+                break;
+            case LEX_BLOCK_COMMENT:
+                if(!star){
+                    i=scan_char(data,i,'*');
+                    if(i==n)break;
+                }
+                if(star&&data[i]=='/')lex=LEX_NONE;
+                star=data[i]=='*';
+                i++;
+                break;
+            }
+        }
+        pos+=n;
+    }
+    
+    void StreamParser::finish(){
+        if(lex==LEX_NUMBER||lex==LEX_LITERAL){
+            end_word(nullptr);
+        }else if(lex==LEX_STRING){
+            unexpected_eof(quote_char('"'));
+        }else if(lex==LEX_COMMENT_START){
+            unexpected('/',token_pos);
+        }
+        switch(state){
+        case STATE_DONE:
+            return;
+        case STATE_VALUE:
+            unexpected_eof("JSON");
+        case STATE_ARRAY_VALUE:
+        case STATE_ARRAY_NEXT:
+            unexpected_eof(quote_char(']'));
+        case STATE_OBJECT_KEY:
+        case STATE_OBJECT_NEXT:
+            unexpected_eof(quote_char('}'));
+        case STATE_OBJECT_COLON:
+            unexpected_eof(quote_char(':'));
+        }
+    }
+    
+    ElementBuilder::ElementBuilder(std::pmr::memory_resource * r,const Query * q,Interner * i) : res(r),query(q),strings(i),pending_node(0),next_node(0),next_whole(true),skip_depth(0),root(JSON_NULL) {
+        stack.reserve(StreamParser::initial_depth);
+    }
+    
+    Element ElementBuilder::take(){
+        stack.clear();
+        pending_key=Key();
+        skip_depth=0;
+        return std::move(root);
+    }
+    
+    bool ElementBuilder::select(bool container){
+        if(skip_depth>0){
+            if(container)skip_depth++;
+            return false;
+        }
+        if(stack.empty()){
+            next_node=0;
+            next_whole=!query||query->is_match(0);
+        }else if(stack.back().whole){
+            next_whole=true;
+        }else{
+            frame_t &parent=stack.back();
+            next_node=parent.e->is_arr()?query->child(parent.node,parent.index++):pending_node;
+            if(next_node==Query::npos){
+                if(container)skip_depth=1;
+                return false;
+            }
+            next_whole=query->is_match(next_node);
+            if(!container&&!next_whole)return false;//a path continues past a value that can't have children
+        }
+        return true;
+    }
+    
+    void ElementBuilder::add(Element &&e,bool container){
+        Element * added;
+        if(stack.empty()){
+            root=std::move(e);
+            added=&root;
+        }else if(stack.back().e->is_arr()){
+            array_t &arr=stack.back().e->get_arr();
+            arr.emplace_back(std::move(e));
+            added=&arr.back();
+        }else{
+            added=&stack.back().e->get_obj().emplace_unsorted(std::move(pending_key),std::move(e));
+        }
+        if(container)stack.push_back({added,next_node,0,next_whole});
+    }
+    
+    void ElementBuilder::begin_object(){
+        if(select(true))add(JSON::Object(object_t(res)),true);
+    }
+    
+    void ElementBuilder::end_object(){
+        if(skip_depth>0){
+            skip_depth--;
+        }else{
+            if(stack.back().e->is_obj())stack.back().e->get_obj().sort();
+            stack.pop_back();
+        }
+    }
+    
+    void ElementBuilder::begin_array(){
+        if(select(true))add(JSON::Array(array_t(res)),true);
+    }
+    
+    void ElementBuilder::end_array(){
+        end_object();
+    }
+    
+    void ElementBuilder::key(std::string_view k){
+        if(skip_depth>0)return;
+        if(!stack.back().whole){
+            pending_node=query->child(stack.back().node,k);
+            if(pending_node==Query::npos)return;
+        }
+        pending_key=(strings&&k.size()>Key::inline_size)?Key::view(strings->intern(k)):Key(k,res);
+    }
+    
+    void ElementBuilder::value(std::string_view s){
+        if(!select(false))return;
+        if(strings&&s.size()>Element::short_size&&s.size()<=strings->max_value_size){//short strings are stored inline anyway
+            add(StringView(strings->intern(s)),false);
+        }else{
+            add(String(s,res),false);
+        }
+    }
+    
+    void ElementBuilder::value(int64_t i){
+        if(select(false))add(i,false);
+    }
+    
+    void ElementBuilder::value(double d){
+        if(select(false))add(d,false);
+    }
+    
+    void ElementBuilder::value(JSON_Literal l){
+        if(select(false))add(l,false);
+    }
+    
+    void Binder::reset(){
+        stack.clear();
+        pending={nullptr,nullptr,{}};
+        skip_depth=0;
+        started=false;
+    }
+    
+    void Binder::mismatch(const BindInternal::slot_t &s,const char * got){
+        throw JSON_Exception(s.name.empty()?std::string():"In "+Util::quote_str_single(std::string(s.name))+": ",s.type->name,got);
+    }
+    
+    void Binder::out_of_range(const BindInternal::slot_t &s,const std::string &value){
+        throw JSON_Exception((s.name.empty()?std::string():"In "+Util::quote_str_single(std::string(s.name))+": ")+"Value "+value+" doesn't fit in type "+Util::quote_str_single(s.type->name));
+    }
+    
+    BindInternal::slot_t Binder::next(){
+        if(skip_depth>0)return {nullptr,nullptr,{}};
+        if(stack.empty()){
+            if(started)return {nullptr,nullptr,{}};
+            started=true;
+            return root;
+        }
+        if(stack.back().type->element)return stack.back().type->element(stack.back().p);
+        return pending;
+    }
+    
+    void Binder::begin(bool array){
+        BindInternal::slot_t s=next();
+        if(!s.type){
+            skip_depth++;
+        }else if(array?!s.type->element:!s.type->member){
+            mismatch(s,array?"Array":"Object");
+        }else{
+            stack.push_back(s);
+        }
+    }
+    
+    void Binder::begin_object(){
+        begin(false);
+    }
+    
+    void Binder::end_object(){
+        if(skip_depth>0){
+            skip_depth--;
+        }else{
+            stack.pop_back();
+        }
+    }
+    
+    void Binder::begin_array(){
+        begin(true);
+    }
+    
+    void Binder::end_array(){
+        end_object();
+    }
+    
+    void Binder::key(std::string_view k){
+        if(skip_depth==0)pending=stack.back().type->member(stack.back().p,k);
+    }
+    
+    void Binder::value(std::string_view s){
+        BindInternal::slot_t slot=next();
+        if(!slot.type)return;
+        if(!slot.type->str)mismatch(slot,"String");
+        slot.type->str(slot.p,s);
+    }
+    
+    void Binder::value(int64_t i){
+        BindInternal::slot_t slot=next();
+        if(!slot.type)return;
+        if(!slot.type->integer)mismatch(slot,"Integer");
+        if(!slot.type->integer(slot.p,i))out_of_range(slot,std::to_string(i));
+    }
+    
+    void Binder::value(double d){
+        BindInternal::slot_t slot=next();
+        if(!slot.type)return;
+        if(!slot.type->number)mismatch(slot,"Double");
+        if(!slot.type->number(slot.p,d)){
+            //format_double writes null for these, 1e999 parses as infinity
+            if(!std::isfinite(d))out_of_range(slot,std::isnan(d)?"NaN":d>0?"Infinity":"-Infinity");
+            char buf[max_double_chars];
+            out_of_range(slot,std::string(buf,format_double(d,buf)));
+        }
+    }
+    
+    void Binder::value(JSON_Literal l){
+        //null leaves members as they are, for arrays that means not adding an element at all
+        if(l==JSON_NULL&&skip_depth==0&&!stack.empty()&&stack.back().type->element)return;
+        BindInternal::slot_t slot=next();
+        if(!slot.type||l==JSON_NULL)return;
+        if(!slot.type->boolean)mismatch(slot,"Boolean");
+        slot.type->boolean(slot.p,l==JSON_TRUE);
+    }
+    
+}
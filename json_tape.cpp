@@ -0,0 +1,344 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#include "json.h"
+#include "json_internal.h"
+#include <stdexcept>
+
+namespace JSON {
+    
+    using namespace Internal;
+    
+    namespace {
+        
+        //containers come last, so anything at or past TAPE_ARRAY has a subtree to skip
+        enum tape_type : uint8_t {
+            TAPE_NULL,
+            TAPE_FALSE,
+            TAPE_TRUE,
+            TAPE_INT,
+            TAPE_DOUBLE,
+            TAPE_STRING,
+            TAPE_STRING_ESCAPED,
+            TAPE_ARRAY,
+            TAPE_OBJECT,
+        };
+        
+        //numbers were already checked while parsing, so this can't throw
+        Element get_tape_number(std::string_view data,size_t pos){
+            return get_number(data,pos);
+        }
+        
+    }
+    
+    Tape::Tape(std::string_view data,size_t max_depth){
+        parse(data,max_depth);
+    }
+    
+    //same grammar and errors as get_element in json.cpp, but values are appended to the tape instead of being built
+    void Tape::parse(std::string_view d,size_t max_depth){
+        if(d.size()>UINT32_MAX) throw std::length_error("Tape inputs are limited to 4GB");
+        data=d;
+        nodes.clear();
+        stack.clear();
+        decoded.clear();
+        decoded_res.release();
+        
+        size_t i=0;
+        
+        //values are counted in the innermost open array, object members are counted by their keys instead
+        auto push=[&](uint8_t type,size_t pos,size_t len){
+            if(!stack.empty()&&nodes[stack.back()].type==TAPE_ARRAY)nodes[stack.back()].len++;
+            nodes.push_back({type,uint32_t(len),uint32_t(pos),0});
+        };
+        
+        auto push_string=[&](){
+            bool escaped;
+            std::string_view raw=get_string_raw(data,i,escaped);
+            push(escaped?TAPE_STRING_ESCAPED:TAPE_STRING,raw.data()-data.data(),raw.size());
+        };
+        
+        auto next_key=[&](){
+            nodes[stack.back()].len++;
+            bool escaped;
+            std::string_view raw=get_string_raw(data,i,escaped);
+            nodes.push_back({uint8_t(escaped?TAPE_STRING_ESCAPED:TAPE_STRING),uint32_t(raw.size()),uint32_t(raw.data()-data.data()),0});
+            skip_whitespace(data,i);
+            expect_char(data,i,':');
+            i++;
+        };
+        
+        try{
+            while(true){
+                skip_whitespace(data,i);
+                if(i>=data.size()) throw std::runtime_error("Expected JSON, got EOF");
+                JSON_Literal l;
+                switch(data[i]){
+                case '[':
+                case '{':{
+                        const bool is_obj=data[i]=='{';
+                        if(stack.size()>=max_depth) throw std::runtime_error("Maximum nesting depth of "+std::to_string(max_depth)+" exceeded at pos "+std::to_string(i));
+                        const char close=is_obj?'}':']';
+                        push(is_obj?TAPE_OBJECT:TAPE_ARRAY,i,0);
+                        i++;
+                        skip_whitespace(data,i);
+                        if(i>=data.size()) throw std::runtime_error(std::string("Expected '")+close+"', got EOF");
+                        if(data[i]==close){
+                            i++;
+                            nodes.back().next=nodes.size();
+                            break;
+                        }
+                        stack.push_back(nodes.size()-1);
+                        if(is_obj)next_key();
+                    }
+                    continue;
+                case '"':
+                    push_string();
+                    break;
+                default:{
+                        const size_t start=i;
+                        if(is_number_start(data,i)){
+                            push(scan_number(data,i).is_int()?TAPE_INT:TAPE_DOUBLE,start,0);
+                            nodes.back().len=i-start;
+                            break;
+                        }else if(get_literal(data,i,l)){
+                            push(l==JSON_NULL?TAPE_NULL:l==JSON_TRUE?TAPE_TRUE:TAPE_FALSE,start,0);
+                            break;
+                        }
+                    }
+                    throw std::runtime_error(std::string("Expected JSON, got '")+data[i]+"' at pos "+std::to_string(i));
+                }
+                
+                //a value just ended, close every container that ends after it, then move on to the next value, trailing commas are allowed
+                while(!stack.empty()){
+                    const bool is_obj=nodes[stack.back()].type==TAPE_OBJECT;
+                    const char close=is_obj?'}':']';
+                    skip_whitespace(data,i);
+                    if(i>=data.size()) throw std::runtime_error(std::string("Expected '")+close+"', got EOF");
+                    if(data[i]!=close){
+                        expect_char(data,i,',');
+                        i++;
+                        skip_whitespace(data,i);
+                        if(i>=data.size()) throw std::runtime_error(std::string("Expected '")+close+"', got EOF");
+                        if(data[i]!=close){
+                            if(is_obj)next_key();
+                            break;
+                        }
+                    }
+                    i++;
+                    nodes[stack.back()].next=nodes.size();
+                    stack.pop_back();
+                }
+                if(stack.empty()) return;
+            }
+        }catch(...){
+            //don't leave half a tape behind
+            data={};
+            nodes.clear();
+            throw;
+        }
+    }
+    
+    TapeValue Tape::root() const {
+        if(nodes.empty()) throw std::out_of_range("Tape::root");
+        return TapeValue(this,0);
+    }
+    
+    size_t Tape::skip(size_t index) const {
+        return nodes[index].type>=TAPE_ARRAY?nodes[index].next:index+1;
+    }
+    
+    std::string_view Tape::str(size_t index) const {
+        const node_t &n=nodes[index];
+        if(n.type==TAPE_STRING) return data.substr(n.pos,n.len);
+        if(n.next==0){
+            char * out=static_cast<char*>(decoded_res.allocate(std::max<size_t>(n.len,1),1));
+            decoded.emplace_back(out,unescape_str(data.substr(n.pos,n.len),out));
+            n.next=decoded.size();
+        }
+        return decoded[n.next-1];
+    }
+    
+    unsigned TapeValue::type() const {
+        return tape->nodes[index].type;
+    }
+    
+    bool TapeValue::is_int() const { return type()==TAPE_INT; }
+    bool TapeValue::is_double() const { return type()==TAPE_DOUBLE; }
+    bool TapeValue::is_number() const { return type()==TAPE_INT||type()==TAPE_DOUBLE; }
+    bool TapeValue::is_str() const { return type()==TAPE_STRING||type()==TAPE_STRING_ESCAPED; }
+    bool TapeValue::is_arr() const { return type()==TAPE_ARRAY; }
+    bool TapeValue::is_obj() const { return type()==TAPE_OBJECT; }
+    bool TapeValue::is_bool() const { return type()==TAPE_TRUE||type()==TAPE_FALSE; }
+    bool TapeValue::is_null() const { return type()==TAPE_NULL; }
+    
+    const char * TapeValue::type_name() const {
+        switch(type()){
+        case TAPE_INT:
+            return "Integer";
+        case TAPE_DOUBLE:
+            return "Double";
+        case TAPE_STRING:
+        case TAPE_STRING_ESCAPED:
+            return "String";
+        case TAPE_ARRAY:
+            return "Array";
+        case TAPE_OBJECT:
+            return "Object";
+        case TAPE_NULL:
+            return "Null";
+        case TAPE_TRUE:
+        case TAPE_FALSE:
+            return "Boolean";
+        default:
+            return "Unknown";
+        }
+    }
+    
+    int64_t TapeValue::get_int() const {
+        if(!is_int()) throw JSON_Exception("Integer",type_name());
+        return get_tape_number(tape->data,tape->nodes[index].pos).get_int();
+    }
+    
+    double TapeValue::get_double() const {
+        if(!is_double()) throw JSON_Exception("Double",type_name());
+        return get_tape_number(tape->data,tape->nodes[index].pos).get_double();
+    }
+    
+    int64_t TapeValue::get_number_int() const {
+        if(!is_number()) throw JSON_Exception("Number",type_name());
+        return get_tape_number(tape->data,tape->nodes[index].pos).get_number_int();
+    }
+    
+    double TapeValue::get_number_double() const {
+        if(!is_number()) throw JSON_Exception("Number",type_name());
+        return get_tape_number(tape->data,tape->nodes[index].pos).get_number_double();
+    }
+    
+    std::string_view TapeValue::get_str_view() const {
+        return is_str()?tape->str(index):throw JSON_Exception("String",type_name());
+    }
+    
+    bool TapeValue::get_bool() const {
+        return is_bool()?type()==TAPE_TRUE:throw JSON_Exception("Boolean",type_name());
+    }
+    
+    size_t TapeValue::size() const {
+        return (is_arr()||is_obj())?tape->nodes[index].len:throw JSON_Exception(std::vector<std::string>{"Array","Object"},type_name());
+    }
+    
+    TapeValue::iterator TapeValue::begin() const {
+        if(!is_arr()&&!is_obj()) throw JSON_Exception(std::vector<std::string>{"Array","Object"},type_name());
+        return iterator(tape,index+1,is_obj());
+    }
+    
+    TapeValue::iterator TapeValue::end() const {
+        if(!is_arr()&&!is_obj()) throw JSON_Exception(std::vector<std::string>{"Array","Object"},type_name());
+        return iterator(tape,tape->nodes[index].next,is_obj());
+    }
+    
+    TapeValue TapeValue::iterator::operator*() const {
+        return TapeValue(tape,is_obj?index+1:index);
+    }
+    
+    std::string_view TapeValue::iterator::key() const {
+        return is_obj?tape->str(index):throw JSON_Exception("Object","Array");
+    }
+    
+    TapeValue::iterator& TapeValue::iterator::operator++(){
+        index=tape->skip(is_obj?index+1:index);
+        return *this;
+    }
+    
+    TapeValue TapeValue::operator[](size_t i) const {
+        if(!is_arr()) throw JSON_Exception("Array",type_name());
+        if(i>=size()) throw std::out_of_range("TapeValue::operator[]");
+        iterator it=begin();
+        while(i--)++it;
+        return *it;
+    }
+    
+    TapeValue TapeValue::operator[](std::string_view key) const {
+        std::optional<TapeValue> v=find(key);
+        return v?*v:throw std::out_of_range("TapeValue::operator[]");
+    }
+    
+    std::string_view TapeValue::key(size_t i) const {
+        if(!is_obj()) throw JSON_Exception("Object",type_name());
+        if(i>=size()) throw std::out_of_range("TapeValue::key");
+        iterator it=begin();
+        while(i--)++it;
+        return it.key();
+    }
+    
+    TapeValue TapeValue::value(size_t i) const {
+        if(!is_obj()) throw JSON_Exception("Object",type_name());
+        if(i>=size()) throw std::out_of_range("TapeValue::value");
+        iterator it=begin();
+        while(i--)++it;
+        return *it;
+    }
+    
+    std::optional<TapeValue> TapeValue::find(std::string_view k) const {
+        if(!is_obj()) throw JSON_Exception("Object",type_name());
+        for(iterator it=begin();it!=end();++it){
+            if(it.key()==k) return *it;
+        }
+        return std::nullopt;
+    }
+    
+    //tapes are at most as deep as the max_depth they were parsed with, so this can't recurse too far
+    Element TapeValue::to_element(std::pmr::memory_resource * res) const {
+        switch(type()){
+        case TAPE_INT:
+        case TAPE_DOUBLE:
+            return get_tape_number(tape->data,tape->nodes[index].pos);
+        case TAPE_STRING:
+            return String(get_str_view(),res);
+        case TAPE_STRING_ESCAPED:{
+                //decoded into a temporary, without keeping a copy in the tape
+                const Tape::node_t &n=tape->nodes[index];
+                if(n.next!=0) return String(get_str_view(),res);
+                std::string str(n.len,'\0');
+                str.resize(unescape_str(tape->data.substr(n.pos,n.len),str.data()));
+                return String(str,res);
+            }
+        case TAPE_ARRAY:{
+                array_t arr(res);
+                arr.reserve(size());
+                for(TapeValue v:*this){
+                    arr.emplace_back(v.to_element(res));
+                }
+                return JSON::Array(std::move(arr));
+            }
+        case TAPE_OBJECT:{
+                object_t obj(res);
+                obj.reserve(size());
+                for(iterator it=begin();it!=end();++it){
+                    obj.emplace_unsorted(it.key(),(*it).to_element(res));
+                }
+                obj.sort();
+                return JSON::Object(std::move(obj));
+            }
+        case TAPE_TRUE:
+            return JSON_TRUE;
+        case TAPE_FALSE:
+            return JSON_FALSE;
+        default:
+            return JSON_NULL;
+        }
+    }
+    
+}
@@ -16,8 +16,11 @@
 #include <cstdint>
 #include <cstdarg>
 #include <atomic>
+#include <memory>
 #include <thread>
 #include <filesystem>
+#include <random>
+#include <exception>
 
 
 #define WIN32_LEAN_AND_MEAN
@@ -113,28 +116,63 @@ static VersionTriplet getCurrentVersion(){
     return version;
 }
 
-static size_t curl_write_text(void *buffer, size_t size, size_t nmemb, void *userp){
+struct json_stream_t {
+    JSON::StreamParser &parser;
+    std::exception_ptr error;
+};
+
+//parses the response as it arrives, a parse error aborts the transfer
+static size_t curl_write_json(void *buffer, size_t size, size_t nmemb, void *userp){
     if(userp){
-        std::string * out=static_cast<std::string*>(userp);
-        (*out)+=std::string(static_cast<char*>(buffer),size*nmemb);//ugly hack, but should be _fine_ as long as the data is text
+        json_stream_t * stream=static_cast<json_stream_t*>(userp);
+        try{
+            stream->parser.feed(std::string_view(static_cast<char*>(buffer),size*nmemb));
+        }catch(...){
+            stream->error=std::current_exception();
+            return 0;
+        }
     }
     return nmemb;
 }
 
-static JSON::Element latest_release_data(JSON_NULL);
+//only the parts of the release that are actually used, everything else is skipped while parsing
+struct Asset {
+    std::string name;
+    std::string browser_download_url;
+    
+    static constexpr auto json_fields=std::make_tuple(
+        JSON::field("name",&Asset::name),
+        JSON::field("browser_download_url",&Asset::browser_download_url)
+    );
+};
+
+struct Release {
+    std::string tag_name;
+    std::vector<Asset> assets;
+    
+    static constexpr auto json_fields=std::make_tuple(
+        JSON::field("tag_name",&Release::tag_name),
+        JSON::field("assets",&Release::assets)
+    );
+};
+
+static Release latest_release;
 
 static VersionTriplet getLatestVersion(){
     if(curl_global_init(CURL_GLOBAL_WIN32|CURL_GLOBAL_SSL)){
         MessageBox(NULL,L"curl_global_init failed",NULL,MB_OK|MB_ICONERROR);
         exit(EXIT_FAILURE);
     }
-    std::string version_json_str;
+    latest_release=Release();
+    JSON::Binder binder(latest_release);
+    JSON::StreamParser parser(binder);
+    json_stream_t stream {parser,nullptr};
     CURL * curl=curl_easy_init();
     if(curl){
         curl_easy_setopt(curl,CURLOPT_URL,"https://api.github.com/repos/coelckers/gzdoom/releases/latest");
         
-        curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,curl_write_text);
-        curl_easy_setopt(curl,CURLOPT_WRITEDATA,&version_json_str);
+        curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,curl_write_json);
+        curl_easy_setopt(curl,CURLOPT_WRITEDATA,&stream);
         curl_easy_setopt(curl,CURLOPT_HEADERDATA,nullptr);
         
         curl_easy_setopt(curl,CURLOPT_USERAGENT,"GZDoom Updater");
@@ -146,7 +184,7 @@ static VersionTriplet getLatestVersion(){
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION,1L);
         
         int err = curl_easy_perform(curl);
-        if(err != CURLE_OK){
+        if(err != CURLE_OK && !stream.error){
             //curl_easy_perform failed -- no internet?
             return (VersionTriplet){0,0,0};
         }
@@ -154,15 +192,18 @@ static VersionTriplet getLatestVersion(){
         curl_easy_cleanup(curl);
         
         try{
-            latest_release_data=JSON::parse(version_json_str);
-        }catch(JSON::JSON_Exception &e){
+            if(stream.error){
+                std::rethrow_exception(stream.error);
+            }
+            parser.finish();
+        }catch(std::exception &e){
             //JSON parse failed
             MessageBoxW(NULL,L"Json Parse Failed",NULL,MB_OK|MB_ICONERROR);
             MessageBoxA(NULL,e.what(),NULL,MB_OK|MB_ICONERROR);
             return (VersionTriplet){0,0,0};
         }
         
-        std::string version_str = latest_release_data.get_obj().at("tag_name");
+        const std::string &version_str = latest_release.tag_name;
         
         if(version_str.size()>2&&version_str[0]=='g'&&version_str[1]>='0'&&version_str[1]<='9'){
             std::vector<std::string> version_triplet_str=Util::split(version_str.substr(1),'.',true);
@@ -245,7 +286,10 @@ static INT_PTR CALLBACK DialogProc(HWND hDialog,UINT msg,WPARAM wParam,LPARAM lP
         }else{
             int download_whole=download_percent_10000/100;
             int download_frac=download_percent_10000%100;
-            std::wstring label_new_text(Util::str_wprintf(L"%d%s / %d%s (%d.%02d%%)",(int)download_cur,download_sig_str[download_cur_sig],(int)download_max,download_sig_str[download_max_sig],download_whole,download_frac));
+            //reused between ticks, so updating the label doesn't allocate
+            static std::wstring label_new_text;
+            label_new_text.clear();
+            Util::str_wprintf_to(label_new_text,L"%d%s / %d%s (%d.%02d%%)",(int)download_cur,download_sig_str[download_cur_sig],(int)download_max,download_sig_str[download_max_sig],download_whole,download_frac);
             SetWindowTextW(GetDlgItem(hDialog,IDC_LABEL1),label_new_text.c_str());
             SendMessage(GetDlgItem(hDialog,IDC_PROGRESS1),PBM_SETPOS,download_percent_10000,0);
         }
@@ -300,14 +344,67 @@ static int updateProgressBar(void * clientp,curl_off_t dltotal,curl_off_t dlnow,
     return aborted;
 }
 
+//the archive is streamed into a preallocated temp file when one can be created, so it never has to fit in memory, and into gzdoom_bin otherwise
+static std::unique_ptr<Util::MappedOutputFile> gzdoom_file;
+static std::fs::path gzdoom_file_path;
+static Util::ChunkedBuffer gzdoom_bin;
+
+struct download_sink_t {
+    CURL * curl;
+    bool sized;
+};
+
+static void discardArchive(){
+    gzdoom_file.reset();
+    if(!gzdoom_file_path.empty()){
+        std::error_code e;
+        std::fs::remove(gzdoom_file_path,e);
+        gzdoom_file_path.clear();
+    }
+    gzdoom_bin.clear();
+}
+
+static void startArchive(CURL * curl){
+    //the headers are in by the first write, so the whole archive can be allocated at once if the server said how big it is
+    curl_off_t content_length=-1;
+    if(curl_easy_getinfo(curl,CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,&content_length)!=CURLE_OK||content_length<0){
+        content_length=0;
+    }
+    //every download gets a file of its own, so updaters running at the same time can't write to or delete each other's archive
+    try{
+        const std::fs::path temp_dir=std::fs::temp_directory_path();
+        std::random_device rd;
+        for(int attempt=0;attempt<4&&!gzdoom_file;attempt++){
+            const std::fs::path path=temp_dir/Util::str_printf("GZDoomUpdater-%lu-%08x.zip",(unsigned long)GetCurrentProcessId(),(unsigned)rd());
+            try{
+                gzdoom_file=std::make_unique<Util::MappedOutputFile>(path.string(),content_length);
+                gzdoom_file_path=path;
+            }catch(std::exception &){
+                //the name is taken, or the file can't be created at all, in which case the other attempts fail the same way
+            }
+        }
+    }catch(std::exception &){
+        //no temp directory
+    }
+    if(!gzdoom_file){
+        //falls back to memory if the temp file can't be created, or there isn't room for it
+        gzdoom_bin.reserve(content_length);
+    }
+}
+
 static size_t curl_write_binary(void *buffer, size_t size, size_t nmemb, void *userp){
     if(userp&&!aborted){
         try{
-            std::vector<std::byte> * data=static_cast<std::vector<std::byte> *>(userp);
-            size_t sz=data->size();
-            size_t len=size*nmemb;
-            data->resize(sz+len);
-            memcpy(static_cast<void*>(data->data()+sz),buffer,len);
+            download_sink_t * sink=static_cast<download_sink_t *>(userp);
+            if(!sink->sized){
+                startArchive(sink->curl);
+                sink->sized=true;
+            }
+            if(gzdoom_file){
+                gzdoom_file->append(buffer,size*nmemb);
+            }else{
+                gzdoom_bin.append(buffer,size*nmemb);
+            }
         }catch(...){
             aborted=true;
         }
@@ -317,7 +414,6 @@ static size_t curl_write_binary(void *buffer, size_t size, size_t nmemb, void *u
 
 
 static std::string gzdoom_download_url;
-static std::vector<std::byte> gzdoom_bin;
 
 static void downloaderThreadProc(){
     CURL * curl=curl_easy_init();
@@ -325,8 +421,10 @@ static void downloaderThreadProc(){
         char * url=gzdoom_download_url.data();
         curl_easy_setopt(curl,CURLOPT_URL,url);
         
+        download_sink_t sink{curl,false};
+        
         curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,curl_write_binary);
-        curl_easy_setopt(curl,CURLOPT_WRITEDATA,&gzdoom_bin);
+        curl_easy_setopt(curl,CURLOPT_WRITEDATA,&sink);
         curl_easy_setopt(curl,CURLOPT_HEADERDATA,nullptr);
         curl_easy_setopt(curl,CURLOPT_XFERINFOFUNCTION,&updateProgressBar);
         curl_easy_setopt(curl,CURLOPT_NOPROGRESS,0L);
@@ -428,12 +526,66 @@ bool zip_file_is_directory(std::fs::path file_path){
     return (file_path.string().back()=='/');
 }
 
+struct zip_chunked_source_t {
+    const Util::ChunkedBuffer * data;
+    zip_uint64_t offset;
+    zip_error_t error;
+};
+
+//lets libzip read the downloaded chunks where they are, instead of copying them into one contiguous buffer
+static zip_int64_t zip_chunked_source(void * userdata,void * data,zip_uint64_t len,zip_source_cmd_t cmd){
+    zip_chunked_source_t * src=static_cast<zip_chunked_source_t *>(userdata);
+    switch(cmd){
+    case ZIP_SOURCE_OPEN:
+        src->offset=0;
+        return 0;
+    case ZIP_SOURCE_READ:{
+            size_t n=src->data->read(src->offset,data,len);
+            src->offset+=n;
+            return n;
+        }
+    case ZIP_SOURCE_CLOSE:
+        return 0;
+    case ZIP_SOURCE_STAT:{
+            zip_stat_t * st=static_cast<zip_stat_t *>(data);
+            zip_stat_init(st);
+            st->size=src->data->size();
+            st->comp_size=st->size;
+            st->comp_method=ZIP_CM_STORE;
+            st->encryption_method=ZIP_EM_NONE;
+            st->valid|=ZIP_STAT_SIZE|ZIP_STAT_COMP_SIZE|ZIP_STAT_COMP_METHOD|ZIP_STAT_ENCRYPTION_METHOD;
+            return sizeof(*st);
+        }
+    case ZIP_SOURCE_ERROR:
+        return zip_error_to_data(&src->error,data,len);
+    case ZIP_SOURCE_SEEK:{
+            zip_int64_t offset=zip_source_seek_compute_offset(src->offset,src->data->size(),data,len,&src->error);
+            if(offset<0) return -1;
+            src->offset=offset;
+            return 0;
+        }
+    case ZIP_SOURCE_TELL:
+        return src->offset;
+    case ZIP_SOURCE_FREE:
+        return 0;
+    case ZIP_SOURCE_SUPPORTS:
+        return ZIP_SOURCE_SUPPORTS_SEEKABLE;
+    default:
+        zip_error_set(&src->error,ZIP_ER_OPNOTSUPP,0);
+        return -1;
+    }
+}
+
 static void unzipGZDoom(){
     
     zip_error_t err;
     zip_error_init(&err);
     
-    zip_source_t * data=zip_source_buffer_create(gzdoom_bin.data(),gzdoom_bin.size(),0,&err);
+    zip_chunked_source_t source{&gzdoom_bin,0,{}};
+    zip_error_init(&source.error);
+    
+    //a downloaded temp file is read straight from its mapping
+    zip_source_t * data=gzdoom_file?zip_source_buffer_create(gzdoom_file->data().data(),gzdoom_file->size(),0,&err):zip_source_function_create(zip_chunked_source,&source,&err);
     if(!data){
         MessageBoxA(NULL,Util::str_printf("Failed to Open Zip: %s",zip_error_strerror(&err)).c_str(),NULL,MB_OK|MB_ICONERROR);
         return;
@@ -534,14 +686,12 @@ static void unzipGZDoom(){
 static void updateGZDoom(HINSTANCE hInst){
     //find url for win64
     {
-        const JSON::array_t &assets=latest_release_data.get_obj().at("assets").get_arr();
         bool found=false;
-        for(const JSON::Element &asset_e:assets){
-            const JSON::object_t &asset=asset_e.get_obj();
-            const std::string &name=asset.at("name").get_str();
+        for(const Asset &asset:latest_release.assets){
+            const std::string &name=asset.name;
             if(((name.find("Windows")!=std::string::npos)||(name.find("windows")!=std::string::npos))&&(name.find("-pdb")==std::string::npos)&&(name.find(".zip")!=std::string::npos)){
                 found=true;
-                gzdoom_download_url=asset.at("browser_download_url").get_str();
+                gzdoom_download_url=asset.browser_download_url;
                 break;
             }
         }
@@ -557,6 +707,7 @@ static void updateGZDoom(HINSTANCE hInst){
     downloaderThread.join();
     
     if(aborted){
+        discardArchive();
         return;
     }
     
@@ -566,10 +717,12 @@ static void updateGZDoom(HINSTANCE hInst){
     }
     try{
         unzipGZDoom();
+        discardArchive();
         if(fatal_unzip_error){
             MessageBox(NULL,L"Fatal Error while Unzipping -- You may need to manually reinstall GZDoom",NULL,MB_OK|MB_ICONERROR);
         }
     }catch(...){
+        discardArchive();
         if(fatal_unzip_error){
             MessageBox(NULL,L"Fatal Error while Unzipping -- You may need to manually reinstall GZDoom",NULL,MB_OK|MB_ICONERROR);
         }
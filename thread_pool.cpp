@@ -0,0 +1,174 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#include "util.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace Util {
+    
+    namespace {
+        //which pool and queue the current thread works for, so that tasks it submits go to its own queue
+        thread_local ThreadPool * current_pool=nullptr;
+        thread_local size_t current_queue=0;
+    }
+    
+    ThreadPool::ThreadPool(size_t threads) : queued(0), next_queue(0), stopping(false) {
+        if(threads==0)threads=std::max(std::thread::hardware_concurrency(),1U);
+        queues.reserve(threads);
+        for(size_t i=0;i<threads;i++){
+            queues.push_back(std::make_unique<queue_t>());
+        }
+        workers.reserve(threads);
+        for(size_t i=0;i<threads;i++){
+            workers.emplace_back(&ThreadPool::run,this,i);
+        }
+    }
+    
+    ThreadPool::~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping=true;
+        }
+        wake.notify_all();
+        for(std::thread &w:workers){
+            w.join();
+        }
+    }
+    
+    ThreadPool& ThreadPool::global(){
+        static ThreadPool pool;
+        return pool;
+    }
+    
+    void ThreadPool::push(std::function<void()> task){
+        const size_t index=(current_pool==this)?current_queue:(next_queue++%queues.size());
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            //taking the lock makes sure a worker that just found nothing to do is already waiting, and gets woken
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            queued++;
+        }
+        wake.notify_one();
+    }
+    
+    //newest task of its own queue first, while it's likely still in cache, otherwise the oldest one of someone else's
+    bool ThreadPool::take(size_t index,std::function<void()> &task){
+        {
+            queue_t &q=*queues[index];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if(!q.tasks.empty()){
+                task=std::move(q.tasks.back());
+                q.tasks.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        for(size_t i=1;i<queues.size();i++){
+            queue_t &q=*queues[(index+i)%queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if(!q.tasks.empty()){
+                task=std::move(q.tasks.front());
+                q.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void ThreadPool::run(size_t index){
+        current_pool=this;
+        current_queue=index;
+        std::function<void()> task;
+        while(true){
+            if(take(index,task)){
+                task();
+                task=nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock,[this]{ return stopping||queued>0; });
+            if(stopping&&queued==0) return;
+        }
+    }
+    
+    namespace {
+        //shared with the helper tasks, which may only get to run after parallel_for returned, by then there's nothing left for them to claim
+        struct for_state_t {
+            size_t n;
+            size_t chunks;
+            size_t chunk_size;
+            const std::function<void(size_t,size_t)> * f;
+            CancelToken cancel;
+            std::atomic<size_t> next{0};
+            std::atomic_bool failed{false};
+            std::atomic_bool skipped{false};
+            std::mutex mutex;
+            std::condition_variable finished;
+            size_t done=0;
+            std::exception_ptr error;
+            
+            void run(){
+                while(true){
+                    const size_t c=next++;
+                    if(c>=chunks) return;
+                    //after an error the remaining runs are only counted, so that parallel_for knows when the started ones are done
+                    if(!failed){
+                        if(cancel.cancelled()){
+                            skipped=true;
+                        }else{
+                            try{
+                                (*f)(c*chunk_size,std::min(n,(c+1)*chunk_size));
+                            }catch(...){
+                                std::lock_guard<std::mutex> lock(mutex);
+                                if(!error) error=std::current_exception();
+                                failed=true;
+                            }
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(++done==chunks) finished.notify_all();
+                }
+            }
+        };
+    }
+    
+    void parallel_for(size_t n,const std::function<void(size_t begin,size_t end)> &f,const CancelToken &cancel,ThreadPool &pool){
+        if(n==0) return;
+        //a few runs per thread, so that threads finishing early can pick up more
+        const size_t max_chunks=(pool.size()+1)*4;
+        auto state=std::make_shared<for_state_t>();
+        state->n=n;
+        state->chunk_size=(n+max_chunks-1)/max_chunks;
+        state->chunks=(n+state->chunk_size-1)/state->chunk_size;
+        state->f=&f;
+        state->cancel=cancel;
+        const size_t helpers=std::min(pool.size(),state->chunks-1);
+        for(size_t i=0;i<helpers;i++){
+            pool.submit([state]{ state->run(); });
+        }
+        state->run();
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->finished.wait(lock,[&]{ return state->done==state->chunks; });
+        }
+        if(state->error) std::rethrow_exception(state->error);
+        if(state->skipped) throw Cancelled();
+    }
+}
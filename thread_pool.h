@@ -0,0 +1,139 @@
+/**
+  * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  * software and associated documentation files (the "Software"), to deal in the Software
+  * without restriction, including without limitation the rights to use, copy, modify,
+  * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  * permit persons to whom the Software is furnished to do so.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Util {
+    
+    //thrown by tasks and parallel loops that were cancelled before they could finish
+    class Cancelled : public std::runtime_error {
+        public:
+            Cancelled() : std::runtime_error("Cancelled") {
+            }
+    };
+    
+    //copies share the same flag, so one copy can be kept to cancel the work that was given the others
+    //work that already started has to check cancelled() itself to stop early, work that hasn't started yet is skipped
+    class CancelToken {
+        public:
+            CancelToken() : flag(std::make_shared<std::atomic_bool>(false)) {
+            }
+            
+            inline void cancel() const { flag->store(true,std::memory_order_relaxed); }
+            inline bool cancelled() const { return flag->load(std::memory_order_relaxed); }
+            
+        private:
+            std::shared_ptr<std::atomic_bool> flag;
+    };
+    
+    //every worker has its own queue, tasks submitted from a worker go to the back of its own queue and are taken from there first,
+    //idle workers steal from the front of the others' queues, tasks submitted from other threads are spread over the queues in turn
+    //tasks must not block waiting on other tasks' futures, that can use up every worker, the parallel_* helpers are safe to nest since the caller takes part
+    class ThreadPool {
+        public:
+            //0 threads uses one per core
+            explicit ThreadPool(size_t threads=0);
+            
+            //runs whatever was still queued, then joins the workers
+            ~ThreadPool();
+            
+            ThreadPool(const ThreadPool &)=delete;
+            ThreadPool& operator=(const ThreadPool &)=delete;
+            
+            //started on first use, with one thread per core
+            static ThreadPool& global();
+            
+            inline size_t size() const { return workers.size(); }
+            
+            template<typename Fn_T>
+            std::future<std::invoke_result_t<std::decay_t<Fn_T>>> submit(Fn_T &&f){
+                using T=std::invoke_result_t<std::decay_t<Fn_T>>;
+                auto task=std::make_shared<std::packaged_task<T()>>(std::forward<Fn_T>(f));
+                std::future<T> result=task->get_future();
+                push([task]{ (*task)(); });
+                return result;
+            }
+            
+            //if 'cancel' is cancelled before the task starts, it doesn't run and its future throws Cancelled
+            template<typename Fn_T>
+            std::future<std::invoke_result_t<std::decay_t<Fn_T>>> submit(Fn_T &&f,const CancelToken &cancel){
+                return submit([f=std::forward<Fn_T>(f),cancel]() mutable {
+                    if(cancel.cancelled()) throw Cancelled();
+                    return std::invoke(f);
+                });
+            }
+            
+        private:
+            struct queue_t {
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks;
+            };
+            
+            void push(std::function<void()> task);
+            bool take(size_t index,std::function<void()> &task);
+            void run(size_t index);
+            
+            std::vector<std::unique_ptr<queue_t>> queues;
+            std::vector<std::thread> workers;
+            std::atomic<size_t> queued;
+            std::atomic<size_t> next_queue;
+            std::mutex sleep_mutex;
+            std::condition_variable wake;
+            bool stopping;
+    };
+    
+    //calls 'f(begin,end)' for runs of indices covering [0,n), spread over the pool's workers and the calling thread, and waits for all of them
+    //the first exception thrown by 'f' is rethrown once the runs already started have finished, the runs that haven't started are skipped
+    //throws Cancelled if 'cancel' made it skip any of them
+    void parallel_for(size_t n,const std::function<void(size_t begin,size_t end)> &f,const CancelToken &cancel=CancelToken(),ThreadPool &pool=ThreadPool::global());
+    
+    //'r' has to be random access, the elements are handed to 'f' in no particular order
+    template<typename R,typename Fn_T>
+    void parallel_for_each(R &r,const Fn_T &f,const CancelToken &cancel=CancelToken(),ThreadPool &pool=ThreadPool::global()) {
+        auto first=std::begin(r);
+        parallel_for(std::size(r),[&](size_t begin,size_t end){
+            for(size_t i=begin;i<end;i++){
+                std::invoke(f,first[i]);
+            }
+        },cancel,pool);
+    }
+    
+    //same as Util::map, but the results have to be default constructible, since they're filled in out of order
+    template<typename R,typename Fn_T>
+    std::vector<typename std::invoke_result<Fn_T,typename R::value_type>::type> parallel_map(const R &r,const Fn_T &f,const CancelToken &cancel=CancelToken(),ThreadPool &pool=ThreadPool::global()) {
+        using T=typename std::invoke_result<Fn_T,typename R::value_type>::type;
+        static_assert(!std::is_same_v<T,bool>,"std::vector<bool> can't be written from several threads at once");
+        std::vector<T> v(std::size(r));
+        auto first=std::begin(r);
+        parallel_for(v.size(),[&](size_t begin,size_t end){
+            for(size_t i=begin;i<end;i++){
+                v[i]=std::invoke(f,first[i]);
+            }
+        },cancel,pool);
+        return v;
+    }
+}
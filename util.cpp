@@ -23,8 +23,21 @@
 #include <memory>
 #include <cstdarg>
 
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
 namespace Util {
     namespace {
+        //large enough that syscall overhead doesn't matter, small enough to keep each write interruptible
+        constexpr size_t write_chunk_size=4_M;
+        
         constexpr char escape(char c){
             switch(c) {
             case '\a':
@@ -53,61 +66,158 @@ namespace Util {
         }
     }
     
+    //formats into a stack buffer first, short output is copied straight into 'out', longer output is formatted again directly into it
+    void vstr_printf_to(std::string &out,const char * fmt,va_list args){
+        char buf[512];
+        va_list args2;
+        va_copy(args2,args);
+        const int len=vsnprintf(buf,sizeof(buf),fmt,args);
+        if(len<0){
+            va_end(args2);
+            throw std::runtime_error("str_printf, invalid format "+quote_str_single(fmt));
+        }
+        if(size_t(len)<sizeof(buf)){
+            out.append(buf,len);
+        }else{
+            const size_t start=out.size();
+            out.resize(start+len);
+            vsnprintf(out.data()+start,len+1,fmt,args2);
+        }
+        va_end(args2);
+    }
+    
+    //the windows crt can count the output first, so 'out' is sized once
+    //elsewhere vswprintf doesn't report how long the output would have been, and fails the same way for an invalid format as for a too small buffer,
+    //so the space in 'out' is only doubled a few times, output that still doesn't fit in max_wprintf_len is treated as an invalid format
+    void vstr_wprintf_to(std::wstring &out,const wchar_t * fmt,va_list args){
+        va_list args2;
+        va_copy(args2,args);
+#ifdef _WIN32
+        const int len=_vscwprintf(fmt,args);
+        if(len<0){
+            va_end(args2);
+            throw std::runtime_error("str_wprintf, invalid format");
+        }
+        const size_t start=out.size();
+        out.resize(start+len);
+        vswprintf(out.data()+start,len+1,fmt,args2);
+#else
+        constexpr size_t max_wprintf_len=64_K;
+        wchar_t buf[512];
+        int len=vswprintf(buf,std::size(buf),fmt,args);
+        if(len>=0){
+            out.append(buf,len);
+        }else{
+            const size_t start=out.size();
+            for(size_t n=std::size(buf)*2;len<0;n*=2){
+                if(n>max_wprintf_len){
+                    out.resize(start);
+                    va_end(args2);
+                    throw std::runtime_error("str_wprintf, invalid format or output longer than 64K");
+                }
+                out.resize(start+n);
+                va_list args3;
+                va_copy(args3,args2);
+                len=vswprintf(out.data()+start,n,fmt,args3);
+                va_end(args3);
+            }
+            out.resize(start+len);
+        }
+#endif
+        va_end(args2);
+    }
+    
+    void str_printf_to(std::string &out,const char * fmt,...){
+        va_list args;
+        va_start(args,fmt);
+        vstr_printf_to(out,fmt,args);
+        va_end(args);
+    }
+    
+    void str_wprintf_to(std::wstring &out,const wchar_t * fmt,...){
+        va_list args;
+        va_start(args,fmt);
+        vstr_wprintf_to(out,fmt,args);
+        va_end(args);
+    }
+    
     std::string str_printf(const char * fmt,...){
-        va_list arg1;
-        va_start(arg1,fmt);
-        va_list arg2;
-        va_copy(arg2,arg1);
-        size_t len=vsnprintf(NULL,0,fmt,arg2);
-        va_end(arg2);
-        std::unique_ptr<char[]> buf(new char[len+1]);
-        vsnprintf(buf.get(),len+1,fmt,arg1);
-        va_end(arg1);
-        return std::string(buf.get(),len);
+        std::string out;
+        va_list args;
+        va_start(args,fmt);
+        vstr_printf_to(out,fmt,args);
+        va_end(args);
+        return out;
     }
     
     std::wstring str_wprintf(const wchar_t * fmt,...){
-        va_list arg1;
-        va_start(arg1,fmt);
-        va_list arg2;
-        va_copy(arg2,arg1);
-        size_t len=vswprintf(NULL,0,fmt,arg2);
-        va_end(arg2);
-        std::unique_ptr<wchar_t[]> buf(new wchar_t[len+1]);
-        vswprintf(buf.get(),len+1,fmt,arg1);
-        va_end(arg1);
-        return std::wstring(buf.get(),len);
-    }
-    
-    std::string quote_str(const std::string &s,char quote_char){
-        std::string str;
-        str+=quote_char;
+        std::wstring out;
+        va_list args;
+        va_start(args,fmt);
+        vstr_wprintf_to(out,fmt,args);
+        va_end(args);
+        return out;
+    }
+    
+    //counts the output first, so it's only allocated once
+    std::string quote_str(std::string_view s,char quote_char){
+        auto needs_escape=[quote_char](char c){
+            return c=='\\'||c==quote_char||escape(c)!=c;
+        };
+        size_t n=s.size()+2;
+        for(char c:s){
+            if(needs_escape(c)) n++;
+        }
+        std::string str(n,quote_char);
+        char * o=str.data()+1;
         for(char c:s){
-            if(c=='\\'||c==quote_char||escape(c)!=c){
-                str+='\\';
-                str+=escape(c);
+            if(needs_escape(c)){
+                *o++='\\';
+                *o++=escape(c);
             }else{
-                str+=c;
+                *o++=c;
             }
         }
-        str+=quote_char;
         return str;
     }
     
-    std::string join(const std::vector<std::string> &v,const std::string &on){
-        std::string o;
-        bool first=true;
-        for(auto &s:v){
-            if(!first)o+=on;
-            o+=s;
-            first=false;
+    namespace {
+        template<typename T>
+        std::string join_impl(const std::vector<T> &v,std::string_view on){
+            if(v.empty()) return {};
+            size_t n=on.size()*(v.size()-1);
+            for(auto &s:v){
+                n+=s.size();
+            }
+            std::string o;
+            o.reserve(n);
+            bool first=true;
+            for(auto &s:v){
+                if(!first)o+=on;
+                o+=s;
+                first=false;
+            }
+            return o;
         }
-        return o;
     }
     
-    std::string join_or(const std::vector<std::string> &v,const std::string &sep_comma,const std::string &sep_or){
+    std::string join(const std::vector<std::string> &v,std::string_view on){
+        return join_impl(v,on);
+    }
+    
+    std::string join(const std::vector<std::string_view> &v,std::string_view on){
+        return join_impl(v,on);
+    }
+    
+    std::string join_or(const std::vector<std::string> &v,std::string_view sep_comma,std::string_view sep_or){
         std::string o;
         const size_t n=v.size();
+        if(n==0) return o;
+        size_t len=sep_or.size()+(n>1?(n-2)*sep_comma.size():0);
+        for(auto &s:v){
+            len+=s.size();
+        }
+        o.reserve(len);
         for(size_t i=0;i<n;i++){
             if(i==(n-1)){
                 o+=sep_or;
@@ -119,6 +229,74 @@ namespace Util {
         return o;
     }
     
+    CharSetFinder::CharSetFinder(std::string_view chars){
+        for(unsigned char c:chars){
+            bits[c>>6]|=uint64_t(1)<<(c&63);
+        }
+    }
+    
+    CharSetFinder::CharSetFinder(const std::vector<char> &chars) : CharSetFinder(std::string_view(chars.data(),chars.size())) {
+    }
+    
+    //builds the trie, then turns it into a full transition table breadth first, so find() never has to follow failure links
+    PatternFinder::PatternFinder(const std::vector<std::string> &patterns) : nodes(1), lengths(patterns.size()) {
+        //0 is the root, so in the trie a 0 transition means there's no child yet
+        nodes[0]={{},0,-1};
+        for(size_t i=0;i<patterns.size();i++){
+            lengths[i]=patterns[i].size();
+            if(patterns[i].empty()) continue;
+            uint32_t n=0;
+            for(unsigned char c:patterns[i]){
+                if(nodes[n].next[c]==0){
+                    nodes[n].next[c]=nodes.size();
+                    nodes.push_back({{},nodes[n].depth+1,-1});
+                }
+                n=nodes[n].next[c];
+            }
+            if(nodes[n].out<0) nodes[n].out=i;
+        }
+        std::vector<uint32_t> fail(nodes.size(),0);
+        std::vector<uint32_t> queue;
+        queue.reserve(nodes.size());
+        for(size_t c=0;c<256;c++){
+            if(nodes[0].next[c]) queue.push_back(nodes[0].next[c]);
+        }
+        for(size_t q=0;q<queue.size();q++){
+            const uint32_t n=queue[q];
+            if(nodes[n].out<0) nodes[n].out=nodes[fail[n]].out;
+            for(size_t c=0;c<256;c++){
+                const uint32_t child=nodes[n].next[c];
+                if(child){
+                    fail[child]=nodes[fail[n]].next[c];
+                    queue.push_back(child);
+                }else{
+                    nodes[n].next[c]=nodes[fail[n]].next[c];
+                }
+            }
+        }
+    }
+    
+    std::pair<size_t,size_t> PatternFinder::find(std::string_view str,size_t offset) const {
+        size_t best=std::string_view::npos;
+        int32_t best_pattern=-1;
+        uint32_t n=0;
+        for(size_t i=offset;i<str.size();i++){
+            n=nodes[n].next[(unsigned char)str[i]];
+            //nothing from here on can start before i+1-depth, so once that's past the best match it can't be beaten
+            const size_t earliest=i+1-nodes[n].depth;
+            if(best!=std::string_view::npos&&earliest>best) break;
+            if(const int32_t p=nodes[n].out;p>=0){
+                const size_t start=i+1-lengths[p];
+                if(best==std::string_view::npos||start<best||(start==best&&p<best_pattern)){
+                    best=start;
+                    best_pattern=p;
+                }
+            }
+        }
+        if(best==std::string_view::npos) return {best,0};
+        return {best,lengths[best_pattern]};
+    }
+    
     std::vector<std::string> split(const std::string &ss,char c,bool split_empty){
         std::vector<std::string> o;
         const char * s=ss.c_str();
@@ -136,8 +314,9 @@ namespace Util {
         size_t i=0,s=0;
         std::vector<std::string> o;
         const size_t n=ss.size();
+        const CharSetFinder set(cv);
         for(;i<n;i++){
-            if(std::find(cv.begin(),cv.end(),ss[i])!=cv.end()){
+            if(set.contains(ss[i])){
                 if(i==s&&!split_empty){
                     ++s;
                     continue;
@@ -168,25 +347,12 @@ namespace Util {
         return o;
     }
     
-    static std::pair<size_t,size_t> first_of_vec(const std::string &str,size_t offset,const std::vector<std::string> &vec){
-        size_t start=std::string::npos;
-        size_t len=std::string::npos;
-        for(auto &elem:vec){
-            if(auto i=str.find(elem,offset);i!=std::string::npos){
-                if(start==std::string::npos||i<start){
-                    start=i;
-                    len=elem.size();
-                }
-            }
-        }
-        return {start,len};
-    }
-    
     std::vector<std::string> split_str(const std::string &ss,const std::vector<std::string> &sv,bool split_empty){
         std::vector<std::string> o;
+        const PatternFinder finder(sv);
         size_t offset=0;
         while(true){
-            auto [start,len]=first_of_vec(ss,offset,sv);
+            auto [start,len]=finder.find(ss,offset);
             if(start==std::string::npos)break;
             if(offset==start&&!split_empty){
                 offset+=len;
@@ -199,9 +365,16 @@ namespace Util {
         return o;
     }
     
+    //regular files are mapped and copied straight into the string, anything that can't be mapped (pipes, empty or special files) goes through a stream
     std::string readfile(const std::string &filename) try {
+        try {
+            MappedFile m(filename);
+            if(!m.data().empty()) return std::string(m.data());
+        }catch(std::exception &e){
+            //let the stream report why the file can't be read
+        }
         std::ostringstream ss;
-        std::ifstream f(filename);
+        std::ifstream f(filename,std::ios::binary);
         if(!f)throw std::runtime_error(strerror(errno));
         ss<<f.rdbuf();
         return ss.str();
@@ -211,16 +384,261 @@ namespace Util {
     
     void writefile(const std::string &filename,const std::string &data) try {
         std::ofstream f(filename);
+        if(!f)throw std::runtime_error(strerror(errno));
         f<<data;
+        f.close();
+        if(!f)throw std::runtime_error(strerror(errno));
     }catch(std::exception &e){
         throw std::runtime_error("Failed to write to "+Util::quote_str_single(filename)+" : "+e.what());
     }
     
-    void writefile_binary(const std::string &filename,const std::vector<std::byte> &data) try {
-        std::ofstream f(filename,std::ios::binary);
-        f.write((const char *)data.data(),data.size());
+    void writefile_binary(const std::string &filename,const std::vector<std::byte> &data){
+        writefile_binary(filename,data.data(),data.size());
+    }
+    
+    void ChunkedBuffer::reserve(size_t n){
+        if(!blocks.empty()||n==0) return;
+        blocks.emplace_back().reserve(n);
+        starts.push_back(0);
+    }
+    
+    void ChunkedBuffer::append(const void * data,size_t len){
+        const std::byte * p=static_cast<const std::byte *>(data);
+        while(len>0){
+            if(blocks.empty()||blocks.back().size()==blocks.back().capacity()){
+                blocks.emplace_back().reserve(chunk_size);
+                starts.push_back(total);
+            }
+            std::vector<std::byte> &block=blocks.back();
+            const size_t n=std::min(len,block.capacity()-block.size());
+            block.insert(block.end(),p,p+n);
+            p+=n;
+            len-=n;
+            total+=n;
+        }
+    }
+    
+    size_t ChunkedBuffer::read(size_t offset,void * out,size_t len) const {
+        if(offset>=total) return 0;
+        len=std::min(len,total-offset);
+        std::byte * o=static_cast<std::byte *>(out);
+        //last block starting at or before 'offset'
+        size_t b=std::upper_bound(starts.begin(),starts.end(),offset)-starts.begin()-1;
+        size_t done=0;
+        while(done<len){
+            const std::vector<std::byte> &block=blocks[b];
+            const size_t from=offset+done-starts[b];
+            const size_t n=std::min(len-done,block.size()-from);
+            memcpy(o+done,block.data()+from,n);
+            done+=n;
+            b++;
+        }
+        return len;
+    }
+    
+    void ChunkedBuffer::clear(){
+        blocks.clear();
+        starts.clear();
+        total=0;
+    }
+
+#ifdef _WIN32
+    
+    MappedFile::MappedFile(const std::string &filename) try : ptr(nullptr), len(0) {
+        HANDLE file=CreateFileA(filename.c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+        if(file==INVALID_HANDLE_VALUE) throw std::runtime_error("CreateFile failed, error "+std::to_string(GetLastError()));
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file,&size)){
+            CloseHandle(file);
+            throw std::runtime_error("GetFileSizeEx failed, error "+std::to_string(GetLastError()));
+        }
+        if(size.QuadPart>0){//empty files can't be mapped
+            HANDLE mapping=CreateFileMappingA(file,NULL,PAGE_READONLY,0,0,NULL);
+            CloseHandle(file);//the mapping keeps the file open
+            if(!mapping) throw std::runtime_error("CreateFileMapping failed, error "+std::to_string(GetLastError()));
+            ptr=static_cast<const char *>(MapViewOfFile(mapping,FILE_MAP_READ,0,0,0));
+            CloseHandle(mapping);//and the view keeps the mapping
+            if(!ptr) throw std::runtime_error("MapViewOfFile failed, error "+std::to_string(GetLastError()));
+            len=size.QuadPart;
+        }else{
+            CloseHandle(file);
+        }
+    }catch(std::exception &e){
+        throw std::runtime_error("Failed to map "+Util::quote_str_single(filename)+" : "+e.what());
+    }
+    
+    MappedFile::~MappedFile(){
+        if(ptr)UnmapViewOfFile(ptr);
+    }
+    
+    MappedOutputFile::MappedOutputFile(const std::string &filename,size_t size) try : ptr(nullptr), len(0), capacity(0), file(INVALID_HANDLE_VALUE) {
+        file=CreateFileA(filename.c_str(),GENERIC_READ|GENERIC_WRITE,0,NULL,CREATE_NEW,FILE_ATTRIBUTE_TEMPORARY,NULL);
+        if(file==INVALID_HANDLE_VALUE) throw std::runtime_error("CreateFile failed, error "+std::to_string(GetLastError()));
+        try{
+            grow(std::max<size_t>(size,1));//empty files can't be mapped
+        }catch(...){
+            CloseHandle(file);
+            DeleteFileA(filename.c_str());
+            throw;
+        }
+    }catch(std::exception &e){
+        throw std::runtime_error("Failed to map "+Util::quote_str_single(filename)+" : "+e.what());
+    }
+    
+    MappedOutputFile::~MappedOutputFile(){
+        if(ptr)UnmapViewOfFile(ptr);
+        LARGE_INTEGER pos;
+        pos.QuadPart=len;
+        if(SetFilePointerEx(file,pos,NULL,FILE_BEGIN))SetEndOfFile(file);
+        CloseHandle(file);
+    }
+    
+    //the view has to be remapped to see the new size
+    void MappedOutputFile::grow(size_t new_capacity){
+        if(ptr)UnmapViewOfFile(ptr);
+        ptr=nullptr;
+        capacity=0;
+        LARGE_INTEGER pos;
+        pos.QuadPart=new_capacity;
+        if(!SetFilePointerEx(file,pos,NULL,FILE_BEGIN)||!SetEndOfFile(file)) throw std::runtime_error("SetEndOfFile failed, error "+std::to_string(GetLastError()));
+        HANDLE mapping=CreateFileMappingA(file,NULL,PAGE_READWRITE,0,0,NULL);
+        if(!mapping) throw std::runtime_error("CreateFileMapping failed, error "+std::to_string(GetLastError()));
+        ptr=static_cast<char *>(MapViewOfFile(mapping,FILE_MAP_WRITE,0,0,0));
+        CloseHandle(mapping);//the view keeps the mapping
+        if(!ptr) throw std::runtime_error("MapViewOfFile failed, error "+std::to_string(GetLastError()));
+        capacity=new_capacity;
+    }
+    
+    //sets the final size up front so the file system can allocate it in one go, then writes in large chunks, checking that every byte made it
+    void writefile_binary(const std::string &filename,const std::byte * data,size_t size) try {
+        HANDLE file=CreateFileA(filename.c_str(),GENERIC_WRITE,0,NULL,CREATE_ALWAYS,FILE_ATTRIBUTE_NORMAL,NULL);
+        if(file==INVALID_HANDLE_VALUE) throw std::runtime_error("CreateFile failed, error "+std::to_string(GetLastError()));
+        auto fail=[file](const char * what){
+            DWORD err=GetLastError();
+            CloseHandle(file);
+            throw std::runtime_error(what+(", error "+std::to_string(err)));
+        };
+        LARGE_INTEGER pos;
+        pos.QuadPart=size;
+        if(!SetFilePointerEx(file,pos,NULL,FILE_BEGIN)||!SetEndOfFile(file)) fail("SetEndOfFile failed");
+        pos.QuadPart=0;
+        if(!SetFilePointerEx(file,pos,NULL,FILE_BEGIN)) fail("SetFilePointerEx failed");
+        size_t done=0;
+        while(done<size){
+            DWORD n=std::min<size_t>(size-done,write_chunk_size);
+            DWORD written=0;
+            if(!WriteFile(file,data+done,n,&written,NULL)) fail("WriteFile failed");
+            if(written==0) fail("WriteFile wrote nothing");
+            done+=written;
+        }
+        if(!CloseHandle(file)) throw std::runtime_error("CloseHandle failed, error "+std::to_string(GetLastError()));
     }catch(std::exception &e){
         throw std::runtime_error("Failed to write to "+Util::quote_str_single(filename)+" : "+e.what());
     }
-}
 
+#else
+    
+    MappedFile::MappedFile(const std::string &filename) try : ptr(nullptr), len(0) {
+        int fd=open(filename.c_str(),O_RDONLY);
+        if(fd<0) throw std::runtime_error(strerror(errno));
+        struct stat st;
+        if(fstat(fd,&st)!=0){
+            int err=errno;
+            close(fd);
+            throw std::runtime_error(strerror(err));
+        }
+        if(st.st_size>0){//empty files can't be mapped
+            void * p=mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+            int err=errno;
+            close(fd);//the mapping keeps the file open
+            if(p==MAP_FAILED) throw std::runtime_error(strerror(err));
+            ptr=static_cast<const char *>(p);
+            len=st.st_size;
+        }else{
+            close(fd);
+        }
+    }catch(std::exception &e){
+        throw std::runtime_error("Failed to map "+Util::quote_str_single(filename)+" : "+e.what());
+    }
+    
+    MappedFile::~MappedFile(){
+        if(ptr)munmap(const_cast<char *>(ptr),len);
+    }
+    
+    MappedOutputFile::MappedOutputFile(const std::string &filename,size_t size) try : ptr(nullptr), len(0), capacity(0), fd(-1) {
+        fd=open(filename.c_str(),O_RDWR|O_CREAT|O_EXCL,0600);
+        if(fd<0) throw std::runtime_error(strerror(errno));
+        try{
+            grow(std::max<size_t>(size,1));//empty files can't be mapped
+        }catch(...){
+            close(fd);
+            unlink(filename.c_str());
+            throw;
+        }
+    }catch(std::exception &e){
+        throw std::runtime_error("Failed to map "+Util::quote_str_single(filename)+" : "+e.what());
+    }
+    
+    MappedOutputFile::~MappedOutputFile(){
+        if(ptr)munmap(ptr,capacity);
+        //if this fails the file just keeps its preallocated size, there's nothing else a destructor can do about it
+        if(ftruncate(fd,len)!=0){}
+        close(fd);
+    }
+    
+    void MappedOutputFile::grow(size_t new_capacity){
+        if(ptr)munmap(ptr,capacity);
+        ptr=nullptr;
+        capacity=0;
+        if(ftruncate(fd,new_capacity)!=0) throw std::runtime_error(strerror(errno));
+        //not every file system supports preallocation, running out of space is the only failure that matters here
+        int err=posix_fallocate(fd,0,new_capacity);
+        if(err==ENOSPC||err==EFBIG) throw std::runtime_error(strerror(err));
+        void * p=mmap(nullptr,new_capacity,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        if(p==MAP_FAILED) throw std::runtime_error(strerror(errno));
+        ptr=static_cast<char *>(p);
+        capacity=new_capacity;
+    }
+    
+    //sets the final size up front so the file system can allocate it in one go, then writes in large chunks, checking that every byte made it
+    void writefile_binary(const std::string &filename,const std::byte * data,size_t size) try {
+        int fd=open(filename.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0666);
+        if(fd<0) throw std::runtime_error(strerror(errno));
+        auto fail=[fd](int err){
+            close(fd);
+            throw std::runtime_error(strerror(err));
+        };
+        if(size>0){
+            //not every file system supports preallocation, running out of space is the only failure that matters here
+            int err=posix_fallocate(fd,0,size);
+            if(err==ENOSPC||err==EFBIG) fail(err);
+        }
+        size_t done=0;
+        while(done<size){
+            ssize_t n=write(fd,data+done,std::min<size_t>(size-done,write_chunk_size));
+            if(n<0){
+                if(errno==EINTR) continue;
+                fail(errno);
+            }
+            if(n==0) fail(EIO);//nothing written and no error, retrying would never finish
+            done+=n;
+        }
+        if(close(fd)!=0) throw std::runtime_error(strerror(errno));
+    }catch(std::exception &e){
+        throw std::runtime_error("Failed to write to "+Util::quote_str_single(filename)+" : "+e.what());
+    }
+
+#endif
+    
+    void MappedOutputFile::append(const void * data,size_t n){
+        if(len+n>capacity){
+            try{
+                grow(std::max(capacity*2,len+n));
+            }catch(std::exception &e){
+                throw std::runtime_error(std::string("Failed to grow mapped file : ")+e.what());
+            }
+        }
+        memcpy(ptr+len,data,n);
+        len+=n;
+    }
+}
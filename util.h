@@ -16,11 +16,15 @@
 #pragma once
 
 #include <map>
+#include <cstdint>
+#include <iterator>
 #include <vector>
 #include <algorithm>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <limits>
+#include <cstdarg>
 
 inline std::string operator"" _s(const char * s,size_t n){
     return {s,n};
@@ -41,19 +45,100 @@ constexpr unsigned long long int operator"" _G(unsigned long long int n){
 namespace Util {
     
     std::string str_printf(const char * fmt,...) __attribute__((format(printf,1,2)));
+    //outside windows, wide output longer than 64K throws like an invalid format does
     std::wstring str_wprintf(const wchar_t * fmt,...) /* __attribute__((format(wprintf,1,2))) */ ;
     
+    //append to 'out' instead of returning a new string, so formatting into a string that's reused doesn't allocate once it's grown large enough
+    void str_printf_to(std::string &out,const char * fmt,...) __attribute__((format(printf,2,3)));
+    void str_wprintf_to(std::wstring &out,const wchar_t * fmt,...) /* __attribute__((format(wprintf,2,3))) */ ;
+    
+    void vstr_printf_to(std::string &out,const char * fmt,va_list args) __attribute__((format(printf,2,0)));
+    void vstr_wprintf_to(std::wstring &out,const wchar_t * fmt,va_list args);
+    
     std::string readfile(const std::string &filename);
     void writefile(const std::string &filename,const std::string &data);
     void writefile_binary(const std::string &filename,const std::vector<std::byte> &data);
+    void writefile_binary(const std::string &filename,const std::byte * data,size_t size);
+    
+    //read only view of a whole file mapped into memory, valid for as long as the object lives
+    class MappedFile {
+        public:
+            explicit MappedFile(const std::string &filename);
+            ~MappedFile();
+            
+            MappedFile(const MappedFile &)=delete;
+            MappedFile& operator=(const MappedFile &)=delete;
+            
+            inline std::string_view data() const { return std::string_view(ptr,len); }
+            
+        private:
+            const char * ptr;
+            size_t len;
+    };
+    
+    //file written through a writable mapping, 'size' bytes are allocated on disk up front so that running out of space
+    //doesn't happen halfway through writing to the mapping, appending past that grows it, when it's destroyed the file is cut down to what was written
+    //the file is always created, opening one that already exists fails, so a file in use by someone else is never truncated or taken over
+    class MappedOutputFile {
+        public:
+            MappedOutputFile(const std::string &filename,size_t size);
+            ~MappedOutputFile();
+            
+            MappedOutputFile(const MappedOutputFile &)=delete;
+            MappedOutputFile& operator=(const MappedOutputFile &)=delete;
+            
+            void append(const void * data,size_t len);
+            
+            //what was written so far, until the next append
+            inline std::string_view data() const { return std::string_view(ptr,len); }
+            inline size_t size() const { return len; }
+            
+        private:
+            void grow(size_t new_capacity);
+            
+            char * ptr;
+            size_t len;
+            size_t capacity;
+#ifdef _WIN32
+            void * file;
+#else
+            int fd;
+#endif
+    };
+    
+    //append only byte buffer that never moves or copies what it already holds, so growing it costs nothing but the new data
+    //it's one block if the final size is known up front, otherwise, or past that size, it's a list of fixed size chunks
+    class ChunkedBuffer {
+        public:
+            static constexpr size_t chunk_size=1_M;
+            
+            //makes the first block 'n' bytes, only has an effect while the buffer is still empty
+            void reserve(size_t n);
+            
+            void append(const void * data,size_t len);
+            
+            //copies up to 'len' bytes starting at 'offset' into 'out', returns how many there were
+            size_t read(size_t offset,void * out,size_t len) const;
+            
+            void clear();
+            
+            inline size_t size() const { return total; }
+            inline bool empty() const { return total==0; }
+            
+        private:
+            //each block is only filled up to the capacity it was created with, so it never reallocates
+            std::vector<std::vector<std::byte>> blocks;
+            std::vector<size_t> starts;//offset of each block's first byte
+            size_t total=0;
+    };
     
-    std::string quote_str(const std::string &s,char quote_char);
+    std::string quote_str(std::string_view s,char quote_char);
     
-    inline std::string quote_str_double(const std::string &s){
+    inline std::string quote_str_double(std::string_view s){
         return quote_str(s,'"');
     }
     
-    inline std::string quote_str_single(const std::string &s){
+    inline std::string quote_str_single(std::string_view s){
         return quote_str(s,'\'');
     }
     
@@ -77,15 +162,171 @@ namespace Util {
         return v;
     }
     
-    std::string join(const std::vector<std::string> &v,const std::string &on=" ");
+    std::string join(const std::vector<std::string> &v,std::string_view on=" ");
+    std::string join(const std::vector<std::string_view> &v,std::string_view on=" ");
     
-    std::string join_or(const std::vector<std::string> &v,const std::string &sep_comma=", ",const std::string &sep_or=", or ");
+    std::string join_or(const std::vector<std::string> &v,std::string_view sep_comma=", ",std::string_view sep_or=", or ");
     
     std::vector<std::string> split(const std::string &str,char split_on,bool split_empty=false);
     std::vector<std::string> split(const std::string &str,const std::vector<char> &split_on,bool split_empty=false);
     std::vector<std::string> split_str(const std::string &str,const std::string &split_on,bool split_empty=false);
     std::vector<std::string> split_str(const std::string &str,const std::vector<std::string> &split_on,bool split_empty=false);
     
+    //finders for SplitRange, find(str,offset) returns the position and length of the first separator at or after offset, or npos
+    
+    struct CharFinder {
+        char c;
+        
+        inline std::pair<size_t,size_t> find(std::string_view str,size_t offset) const {
+            return {str.find(c,offset),1};
+        }
+    };
+    
+    //any of a set of chars, looked up in a 256 bit table instead of searching the set for every char
+    class CharSetFinder {
+        public:
+            explicit CharSetFinder(std::string_view chars);
+            explicit CharSetFinder(const std::vector<char> &chars);
+            
+            inline bool contains(char c) const {
+                const unsigned char u=c;
+                return (bits[u>>6]>>(u&63))&1;
+            }
+            
+            inline std::pair<size_t,size_t> find(std::string_view str,size_t offset) const {
+                for(size_t i=offset;i<str.size();i++){
+                    if(contains(str[i])) return {i,1};
+                }
+                return {std::string_view::npos,0};
+            }
+            
+        private:
+            uint64_t bits[4]={};
+    };
+    
+    struct StringFinder {
+        std::string_view s;
+        
+        inline std::pair<size_t,size_t> find(std::string_view str,size_t offset) const {
+            if(s.empty()) return {std::string_view::npos,0};
+            return {str.find(s,offset),s.size()};
+        }
+    };
+    
+    //any of several strings, matched in a single pass with an Aho-Corasick automaton
+    //if more than one match starts at the same position, the one that comes first in 'patterns' wins, empty patterns never match
+    class PatternFinder {
+        public:
+            explicit PatternFinder(const std::vector<std::string> &patterns);
+            
+            std::pair<size_t,size_t> find(std::string_view str,size_t offset) const;
+            
+        private:
+            struct node_t {
+                uint32_t next[256];
+                uint32_t depth;
+                int32_t out;//longest pattern that is a suffix of this node, -1 if none
+            };
+            
+            std::vector<node_t> nodes;
+            std::vector<uint32_t> lengths;
+    };
+    
+    //lazily splits 'str' into views of it, without copying or allocating, 'str' must outlive the range and its tokens
+    //with split_empty every separator ends a token, but like with Util::split a separator at the end doesn't start an empty one, so "a,,b," gives "a","","b"
+    //otherwise empty tokens are skipped
+    template<typename Finder>
+    class SplitRange {
+        public:
+            class iterator {
+                public:
+                    using iterator_category=std::forward_iterator_tag;
+                    using value_type=std::string_view;
+                    using difference_type=std::ptrdiff_t;
+                    using pointer=const std::string_view*;
+                    using reference=const std::string_view&;
+                    
+                    iterator() : range(nullptr), next(std::string_view::npos), done(true) {
+                    }
+                    
+                    inline reference operator*() const { return token; }
+                    inline pointer operator->() const { return &token; }
+                    
+                    inline iterator& operator++(){
+                        advance();
+                        return *this;
+                    }
+                    
+                    inline iterator operator++(int){
+                        iterator it=*this;
+                        advance();
+                        return it;
+                    }
+                    
+                    inline bool operator==(const iterator &other) const { return done==other.done&&(done||(range==other.range&&next==other.next)); }
+                    inline bool operator!=(const iterator &other) const { return !(*this==other); }
+                    
+                private:
+                    friend class SplitRange;
+                    
+                    iterator(const SplitRange * r) : range(r), next(0), done(false) {
+                        advance();
+                    }
+                    
+                    //'next' is where the token after this one starts, npos if this one was the last
+                    void advance(){
+                        const std::string_view str=range->str;
+                        while(next!=std::string_view::npos){
+                            auto [start,len]=range->finder.find(str,next);
+                            const bool last=start==std::string_view::npos;
+                            token=str.substr(next,(last?str.size():start)-next);
+                            next=last?std::string_view::npos:start+len;
+                            if(!token.empty()||(range->split_empty&&!last)) return;
+                        }
+                        done=true;
+                    }
+                    
+                    const SplitRange * range;
+                    size_t next;
+                    bool done;
+                    std::string_view token;
+            };
+            
+            SplitRange(std::string_view s,Finder f,bool e) : str(s), finder(std::move(f)), split_empty(e) {
+            }
+            
+            inline iterator begin() const { return iterator(this); }
+            inline iterator end() const { return iterator(); }
+            
+            std::vector<std::string_view> to_vector() const {
+                return std::vector<std::string_view>(begin(),end());
+            }
+            
+        private:
+            std::string_view str;
+            Finder finder;
+            bool split_empty;
+    };
+    
+    //unlike Util::split, a separator at the start only gives an empty token with split_empty
+    inline SplitRange<CharFinder> split_view(std::string_view str,char split_on,bool split_empty=false){
+        return {str,CharFinder{split_on},split_empty};
+    }
+    
+    //splits on any of the chars in 'split_on'
+    inline SplitRange<CharSetFinder> split_any_view(std::string_view str,std::string_view split_on,bool split_empty=false){
+        return {str,CharSetFinder(split_on),split_empty};
+    }
+    
+    //unlike Util::split_str, these don't give a last empty token when 'str' is empty or ends with a separator
+    inline SplitRange<StringFinder> split_str_view(std::string_view str,std::string_view split_on,bool split_empty=false){
+        return {str,StringFinder{split_on},split_empty};
+    }
+    
+    inline SplitRange<PatternFinder> split_str_view(std::string_view str,const std::vector<std::string> &split_on,bool split_empty=false){
+        return {str,PatternFinder(split_on),split_empty};
+    }
+    
     template<typename R,typename Fn_T>
     std::vector<typename std::invoke_result<Fn_T,typename R::value_type>::type> map(const R &r,const Fn_T &f) {
         std::vector<typename std::invoke_result<Fn_T,typename R::value_type>::type> v;